@@ -0,0 +1,340 @@
+// benchmark driver for Fraction, the expression parser, Stack, Polynomial and
+// MultiPolynomial
+//
+//   benchmark [--filter <substring>] [--max-size <n>] [--min-time <ms>] [--format json|csv]
+//
+// every case prints one record (JSON lines by default) so results can be
+// diffed and tracked across releases
+#include "expression.hpp"
+#include "multipoly.hpp"
+#include "polynomial.hpp"
+#include "stack.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string filter;
+    std::size_t max_size = 1000000;
+    double min_time_ms = 200.0;
+    bool csv = false;
+};
+
+// quadratic cases above this many basic steps are reported as skipped
+constexpr double WORK_BUDGET = 5e8;
+
+// sparse exponents reach 1000n and products add two of them; beyond this
+// many terms they would not fit in an int
+constexpr std::size_t MAX_SPARSE_TERMS = INT_MAX / 2 / 1000;
+
+volatile double sink;
+
+void report(const Options &options, const std::string &suite, const std::string &name, const std::string &shape,
+            std::size_t size, std::size_t iterations, double mean_ns, double min_ns) {
+    if (options.csv) {
+        std::cout << suite << ',' << name << ',' << shape << ',' << size << ',' << iterations << ','
+                  << mean_ns << ',' << min_ns << '\n';
+    } else {
+        std::cout << "{\"suite\":\"" << suite << "\",\"case\":\"" << name << "\",\"shape\":\"" << shape
+                  << "\",\"size\":" << size << ",\"iterations\":" << iterations
+                  << ",\"mean_ns\":" << mean_ns << ",\"min_ns\":" << min_ns << "}\n";
+    }
+    std::cout.flush();
+}
+
+void run_case(const Options &options, const std::string &suite, const std::string &name, const std::string &shape,
+              std::size_t size, double work, const std::function<void()> &body) {
+    std::string id = suite + "/" + name + "/" + shape + "/" + std::to_string(size);
+    if (!options.filter.empty() && id.find(options.filter) == std::string::npos) {
+        return;
+    }
+    if (size > options.max_size) {
+        return;
+    }
+    if (work > WORK_BUDGET) {
+        report(options, suite, name, shape + ":skipped", size, 0, 0.0, 0.0);
+        return;
+    }
+    using clock = std::chrono::steady_clock;
+    std::size_t iterations = 0;
+    double total_ns = 0.0;
+    double min_ns = 0.0;
+    while (iterations == 0 || total_ns < options.min_time_ms * 1e6) {
+        auto start = clock::now();
+        body();
+        double elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        total_ns += elapsed;
+        min_ns = iterations == 0 || elapsed < min_ns ? elapsed : min_ns;
+        ++iterations;
+    }
+    report(options, suite, name, shape, size, iterations, total_ns / iterations, min_ns);
+}
+
+std::vector<std::size_t> sizes_up_to(std::size_t limit) {
+    std::vector<std::size_t> sizes;
+    for (std::size_t n = 10; n <= limit; n *= 10) {
+        sizes.push_back(n);
+    }
+    return sizes;
+}
+
+std::string make_expression(std::size_t operands, std::size_t depth, std::mt19937_64 &rng) {
+    // terms a * b / c joined by '+' or '-', wrapped in `depth` levels of
+    // parentheses. Every denominator divides 2520, the lcm of 1..9, and groups are
+    // only ever added or subtracted, so numerators grow linearly with the
+    // operand count and the fractions stay far inside 64 bits at any size
+    std::string expr;
+    std::size_t groups = depth + 1;
+    std::size_t per_group = std::max<std::size_t>(3, operands / groups / 3 * 3);
+    for (std::size_t i = 0; i < operands; ++i) {
+        if (i > 0) {
+            std::size_t position = i % 3;
+            expr += position == 1 ? '*' : position == 2 ? '/' : rng() % 2 == 0 ? '+' : '-';
+        }
+        if (depth > 0 && i % per_group == 0 && i / per_group < groups) {
+            expr += '(';
+        }
+        expr += std::to_string(rng() % 9 + 1);
+    }
+    // groups are only closed at the end, so they nest `depth` levels deep
+    std::size_t open = 0;
+    for (char ch : expr) {
+        open += ch == '(';
+    }
+    expr.append(open, ')');
+    return expr;
+}
+
+Polynomial make_polynomial(std::size_t terms, bool dense, std::mt19937_64 &rng) {
+    // dense: exponents 0..n-1, sparse: exponents spread over 0..1000n
+    // terms are added in ascending order so each insertion is O(1)
+    Polynomial poly;
+    std::uniform_real_distribution<double> coeff(-10.0, 10.0);
+    int exponent = 0;
+    for (std::size_t i = 0; i < terms; ++i) {
+        poly.addTerm(coeff(rng) + 20.0, exponent);
+        exponent += dense ? 1 : static_cast<int>(1 + rng() % 1000);
+    }
+    return poly;
+}
+
+void bench_fraction(const Options &options, std::mt19937_64 &rng) {
+    const std::size_t count = std::min<std::size_t>(100000, options.max_size);
+    std::vector<Fraction> values;
+    for (std::size_t i = 0; i < count; ++i) {
+        values.emplace_back(static_cast<i64>(rng() % 1000 + 1), static_cast<i64>(rng() % 1000 + 1));
+    }
+    const std::pair<const char *, const char *> mixes[] = {
+        {"add", "+"}, {"mul", "*"}, {"div", "/"}, {"mixed", "+-*/"}};
+    for (const auto &[name, ops] : mixes) {
+        std::string mix = ops;
+        run_case(options, "fraction", name, "random", count, static_cast<double>(count), [&] {
+            i64 checksum = 0;
+            for (std::size_t i = 1; i < count; ++i) {
+                const Fraction &a = values[i - 1];
+                const Fraction &b = values[i];
+                Fraction r;
+                switch (mix[i % mix.size()]) {
+                case '+': r = a + b; break;
+                case '-': r = a - b; break;
+                case '*': r = a * b; break;
+                default: r = a / b; break;
+                }
+                checksum += r.numerator;
+            }
+            sink = static_cast<double>(checksum);
+        });
+    }
+}
+
+void bench_expression(const Options &options, std::mt19937_64 &rng) {
+    for (std::size_t operands : sizes_up_to(options.max_size)) {
+        for (std::size_t depth : {std::size_t{0}, std::size_t{8}, std::size_t{64}}) {
+            std::string expr = make_expression(operands, depth, rng);
+            std::string shape = "depth" + std::to_string(depth);
+            run_case(options, "expression", "serial", shape, operands, static_cast<double>(operands), [&] {
+                sink = static_cast<double>(expression_evaluate(expr).numerator);
+            });
+            run_case(options, "expression", "parallel", shape, operands, static_cast<double>(operands), [&] {
+                sink = static_cast<double>(expression_evaluate_parallel(expr).numerator);
+            });
+        }
+    }
+}
+
+void bench_stack(const Options &options) {
+    for (std::size_t n : sizes_up_to(options.max_size)) {
+        run_case(options, "stack", "push_pop", "fraction", n, static_cast<double>(n), [&] {
+            Stack<Fraction> stack;
+            for (std::size_t i = 0; i < n; ++i) {
+                stack.push(Fraction(static_cast<i64>(i), 1));
+            }
+            i64 checksum = 0;
+            while (!stack.empty()) {
+                checksum += stack.pop().numerator;
+            }
+            sink = static_cast<double>(checksum);
+        });
+        run_case(options, "stack", "push_pop", "char", n, static_cast<double>(n), [&] {
+            Stack<char> stack;
+            for (std::size_t i = 0; i < n; ++i) {
+                stack.push(static_cast<char>(i));
+            }
+            int checksum = 0;
+            while (!stack.empty()) {
+                checksum += stack.pop();
+            }
+            sink = checksum;
+        });
+    }
+}
+
+void bench_polynomial(const Options &options, std::mt19937_64 &rng) {
+    for (bool dense : {true, false}) {
+        std::string shape = dense ? "dense" : "sparse";
+        for (std::size_t n : sizes_up_to(options.max_size)) {
+            if (!dense && n > MAX_SPARSE_TERMS) {
+                break;
+            }
+            Polynomial a = make_polynomial(n, dense, rng);
+            Polynomial b = make_polynomial(n, dense, rng);
+            double linear = static_cast<double>(n);
+            double quadratic = linear * linear;
+            run_case(options, "polynomial", "add", shape, n, quadratic, [&] {
+                Polynomial sum = a + b;
+                sink = sum.evaluate(0.5);
+            });
+            // every product term is inserted into a list that holds up to n (dense) or n^2 (sparse) terms
+            double product_work = dense ? quadratic * linear : quadratic * quadratic;
+            run_case(options, "polynomial", "mul", shape, n, product_work, [&] {
+                Polynomial product = a * b;
+                sink = product.evaluate(0.5);
+            });
+            run_case(options, "polynomial", "evaluate", shape, n, linear, [&] {
+                sink = a.evaluate(0.999);
+            });
+            // built on the first call, cached afterwards
+            run_case(options, "polynomial", "evaluate_prepared", shape, n, linear, [&] {
+                sink = a.prepared()(0.999);
+            });
+            run_case(options, "polynomial", "derivative", shape, n, quadratic, [&] {
+                Polynomial deriv = a.derivative();
+                sink = deriv.evaluate(0.5);
+            });
+            // a + b - a + ... over eight operands: seven list walks with
+            // seven temporaries, against one k-way merge (poly calc)
+            std::vector<const Polynomial *> operands;
+            std::vector<double> scales;
+            for (int k = 0; k < 8; ++k) {
+                operands.push_back(k % 2 == 0 ? &a : &b);
+                scales.push_back(k % 3 == 2 ? -1.0 : 1.0);
+            }
+            run_case(options, "polynomial", "sum8_chained", shape, n, 8.0 * quadratic, [&] {
+                Polynomial sum = *operands[0];
+                for (std::size_t k = 1; k < operands.size(); ++k) {
+                    sum = scales[k] < 0 ? sum - *operands[k] : sum + *operands[k];
+                }
+                sink = sum.evaluate(0.5);
+            });
+            run_case(options, "polynomial", "sum8_fused", shape, n, 8.0 * linear, [&] {
+                Polynomial sum = Polynomial::linearCombination(operands, scales);
+                sink = sum.evaluate(0.5);
+            });
+            // Aberth iteration: about 20 sweeps of O(degree^2); the sparse
+            // shapes span 1000n exponents and are far beyond the budget
+            if (dense) {
+                run_case(options, "polynomial", "roots", shape, n, 20.0 * quadratic, [&] {
+                    sink = a.roots().front().residual;
+                });
+                // divide and conquer over FFT products: O(n log^2 n)
+                double log_n = std::log2(linear + 1.0);
+                run_case(options, "polynomial", "shift", shape, n, linear * log_n * log_n, [&] {
+                    Polynomial shifted = a.shift(0.001);
+                    sink = shifted.evaluate(0.5);
+                });
+                // small coefficients keep p(inner) finite at every size
+                Polynomial inner;
+                inner.addTerm(0.25, 3);
+                inner.addTerm(-0.5, 1);
+                inner.addTerm(0.125, 0);
+                run_case(options, "polynomial", "compose", shape, n, 3.0 * linear * log_n * log_n, [&] {
+                    Polynomial composed = a.compose(inner);
+                    sink = composed.evaluate(0.5);
+                });
+            }
+        }
+    }
+}
+
+void bench_multipoly(const Options &options) {
+    // (1 + w + x + y + z)^k: dense in four variables, C(k + 4, 4) terms
+    MultiPolynomial base = MultiPolynomial::parse("1 + w + x + y + z");
+    MultiPolynomial power = base;
+    for (int k = 2; k <= 16; ++k) {
+        power = power * base;
+        if (k % 4 != 0) {
+            continue;
+        }
+        std::size_t n = power.termCount();
+        double linear = static_cast<double>(n);
+        run_case(options, "multipoly", "add", "dense4", n, linear, [&] {
+            MultiPolynomial sum = power + base;
+            sink = static_cast<double>(sum.termCount());
+        });
+        run_case(options, "multipoly", "mul", "dense4", n, linear * linear * 10.0, [&] {
+            MultiPolynomial product = power * power;
+            sink = static_cast<double>(product.termCount());
+        });
+        std::vector<double> point{0.5, -0.25, 0.75, 0.125};
+        run_case(options, "multipoly", "evaluate", "dense4", n, linear, [&] {
+            sink = power.evaluate(point);
+        });
+        run_case(options, "multipoly", "derivative", "dense4", n, linear, [&] {
+            MultiPolynomial deriv = power.partialDerivative('x');
+            sink = static_cast<double>(deriv.termCount());
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--max-size" && i + 1 < argc) {
+            options.max_size = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.min_time_ms = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--format" && i + 1 < argc) {
+            options.csv = std::string(argv[++i]) == "csv";
+        } else {
+            std::cerr << "usage: benchmark [--filter <substring>] [--max-size <n>] [--min-time <ms>] [--format json|csv]\n";
+            return 1;
+        }
+    }
+    if (options.csv) {
+        std::cout << "suite,case,shape,size,iterations,mean_ns,min_ns\n";
+    }
+
+    std::mt19937_64 rng(20240601);
+    bench_fraction(options, rng);
+    bench_expression(options, rng);
+    bench_stack(options);
+    bench_polynomial(options, rng);
+    bench_multipoly(options);
+    return 0;
+}
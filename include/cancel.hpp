@@ -0,0 +1,95 @@
+#pragma once
+
+// cooperative cancellation and budgets for long-running commands.
+// a command runs inside a cancel::Scope; the kernels call checkpoint() at
+// loop boundaries, which throws cancel::Cancelled once the command has been
+// interrupted (Ctrl-C), has run past its time limit or holds more memory
+// than its budget. outside a scope a checkpoint costs one thread-local load.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+namespace cancel {
+
+enum class Reason { Interrupted, Timeout, Memory };
+
+class Cancelled : public std::runtime_error {
+public:
+    explicit Cancelled(Reason reason);
+    Reason reason() const { return reason_; }
+
+private:
+    Reason reason_;
+};
+
+struct Limits {
+    std::chrono::milliseconds timeout{0}; // 0 = no limit
+    std::size_t memory_bytes = 0;         // 0 = no limit
+};
+
+// receives the running task and its completed fraction, at most a few
+// times per second and only after the command has run for a while; a null
+// task means the command finished and the report can be cleared
+using ProgressSink = std::function<void(const char *task, double fraction)>;
+
+struct Token;
+
+// constinit lets the fast paths read these directly instead of going
+// through a TLS init wrapper
+extern constinit thread_local Token *current;
+extern constinit thread_local std::ptrdiff_t unflushed_bytes; // charged since the last checkpoint
+
+// async-signal-safe; cancels the running interruptible scope
+void interrupt();
+
+class Scope {
+public:
+    Scope(const Limits &limits, bool interruptible, ProgressSink progress = {});
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    Token *token_;
+    Token *previous_;
+};
+
+// runs a pool task under the token of the thread that queued it
+class Adopt {
+public:
+    explicit Adopt(Token *token);
+    ~Adopt();
+    Adopt(const Adopt &) = delete;
+    Adopt &operator=(const Adopt &) = delete;
+
+private:
+    Token *previous_;
+};
+
+void check(); // the slow path of checkpoint()
+void report(const char *task, std::size_t done, std::size_t total);
+
+constexpr void checkpoint() {
+    if (!std::is_constant_evaluated() && current) {
+        check();
+    }
+}
+
+// a checkpoint that also feeds the progress sink
+inline void progress(const char *task, std::size_t done, std::size_t total) {
+    if (current) {
+        report(task, done, total);
+    }
+}
+
+// memory taken (positive) or given back (negative) by the calling thread;
+// compared against the budget at the next checkpoint
+inline void charge(std::ptrdiff_t bytes) {
+    unflushed_bytes += bytes;
+}
+
+} // namespace cancel
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "cancel.hpp"
+#include "poly_store.hpp"
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+// per-session state; copies share the polynomial stores
+struct CLIContext {
+    std::shared_ptr<PolyStore> polynomials = std::make_shared<PolyStore>();
+    std::shared_ptr<MultiPolyStore> multipolys = std::make_shared<MultiPolyStore>();
+    std::shared_ptr<CompactPolyStore> compacts = std::make_shared<CompactPolyStore>();
+    std::shared_ptr<DiskPolyStore> disks = std::make_shared<DiskPolyStore>();
+    cancel::Limits limits;             // budget of every command, see `set`
+    bool interruptible = false;        // Ctrl-C cancels the running command
+    std::ostream *progress = nullptr;  // where long commands draw their progress
+    bool show_progress = true;
+    DiskLimits disk;                   // working memory and files of poly d*
+};
+
+enum class CommandStatus { Continue, Exit };
+
+// runs one command line of the calculator language; output goes to out and
+// follow-up input (interactive poly new) is read from in.
+// errors are thrown, the caller decides how to report them
+CommandStatus execute_command(CLIContext &ctx, const std::string &line, std::istream &in, std::ostream &out);
+std::string command_key(const std::string &line); // "poly add A B" -> "poly add"
+
+void print_banner(std::ostream &out);
+void print_help(std::ostream &out);
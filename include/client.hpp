@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+struct ServerResponse {
+    bool ok;
+    std::string body;
+};
+
+// blocking client for the line protocol described in server.hpp
+class ServerConnection {
+public:
+    explicit ServerConnection(const std::string &socket_path);
+    ServerConnection(const ServerConnection &) = delete;
+    ServerConnection &operator=(const ServerConnection &) = delete;
+    ~ServerConnection();
+
+    ServerResponse request(const std::string &line);
+
+private:
+    int fd_;
+    std::string buffer_;
+
+    void fill();
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "polynomial.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// sparse polynomial with 64-bit exponents in a compact encoding, for huge
+// degrees with few terms. The coefficients are packed in one array in
+// descending exponent order; the exponents are a byte stream of varint
+// deltas between neighbouring terms, cut into runs of RUN_LENGTH terms that
+// each start with their absolute exponent (zigzag varint), so a run decodes
+// on its own. A term costs 8 bytes of coefficient and 1-10 bytes of delta,
+// against a 16-byte PolyTerm plus allocator overhead per node.
+// terms are decoded as they stream; there is no random access by index.
+// exponent arithmetic is checked and throws instead of wrapping around
+struct CompactPolynomial {
+	static constexpr std::size_t RUN_LENGTH = 128;
+
+	struct Term {
+		double coefficient;
+		std::int64_t exponent;
+	};
+
+	// walks the terms in descending exponent order
+	class Cursor {
+	public:
+		bool done() const { return index == count; }
+		Term term() const { return {poly->coefficients[index], exponent}; }
+		void next();
+
+	private:
+		friend struct CompactPolynomial;
+		const CompactPolynomial *poly = nullptr;
+		std::size_t index = 0;
+		std::size_t count = 0;
+		std::size_t offset = 0; // next byte of the exponent stream
+		std::int64_t exponent = 0;
+		void decode();
+	};
+
+	// takes terms in strictly descending exponent order; zero coefficients
+	// are dropped
+	class Builder {
+	public:
+		void append(double coefficient, std::int64_t exponent);
+		CompactPolynomial finish();
+
+	private:
+		std::vector<double> coefficients;
+		std::vector<std::uint8_t> exponents;
+		std::vector<std::size_t> runs;
+		std::int64_t last = 0;
+	};
+
+	CompactPolynomial() = default;
+	explicit CompactPolynomial(const Polynomial &poly);
+	// throws if an exponent does not fit the int of a PolyTerm
+	Polynomial toPolynomial() const;
+
+	// "n c1 e1 c2 e2 ...", as createPoly, with 64-bit exponents in any order
+	static CompactPolynomial read(std::istream &is);
+
+	friend CompactPolynomial operator+(const CompactPolynomial &a, const CompactPolynomial &b);
+	CompactPolynomial operator-() const;
+	friend CompactPolynomial operator-(const CompactPolynomial &a, const CompactPolynomial &b);
+	friend CompactPolynomial operator*(const CompactPolynomial &a, const CompactPolynomial &b);
+
+	double evaluate(double x) const;
+	CompactPolynomial derivative() const;
+
+	Cursor begin() const;
+	Cursor run(std::size_t index) const; // first term of run index
+	std::size_t runCount() const;
+	std::size_t termCount() const;
+	std::size_t memoryBytes() const; // heap bytes held by the encoding
+	MemoryUsage memoryUsage() const;
+
+	void print(std::ostream &os = std::cout) const;
+
+	private:
+	std::vector<double> coefficients;
+	std::vector<std::uint8_t> exponents;
+	std::vector<std::size_t> runs; // byte offset of every run in exponents
+};
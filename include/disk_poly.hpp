@@ -0,0 +1,110 @@
+#pragma once
+
+#include "compact_poly.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// working memory of out-of-core operations and where they put their files
+struct DiskLimits {
+	std::size_t memory_bytes = std::size_t{64} << 20;
+	std::string directory; // empty: the system temporary directory
+};
+
+// sparse polynomial kept on disk as a sorted term file, for sums and
+// products with more terms than fit in memory. The file holds the
+// (coefficient, exponent) records in descending exponent order, without
+// repeated exponents or zeros. Operations stream their operands through
+// fixed buffers into a new file: addition is a merge; multiplication forms
+// the products of blocks that fit in memory, spills each as a sorted run
+// and k-way merges the runs. Their memory stays within
+// DiskLimits::memory_bytes (plus a few 64 KiB buffers) whatever the size of
+// the operands. The files are temporaries, removed with the last
+// DiskPolynomial that refers to them
+class DiskPolynomial {
+	struct File;
+
+public:
+	using Term = CompactPolynomial::Term;
+
+	// buffered sequential read of the terms
+	class Reader {
+	public:
+		Reader(const DiskPolynomial &poly, std::size_t buffer_bytes);
+		~Reader();
+		Reader(const Reader &) = delete;
+		Reader &operator=(const Reader &) = delete;
+
+		bool done() const { return position == filled; }
+		const Term &term() const { return buffer[position]; }
+		void next() {
+			if (++position == filled) {
+				refill();
+			}
+		}
+
+	private:
+		std::shared_ptr<const File> file; // kept alive while reading
+		std::ifstream in;
+		std::vector<Term> buffer;
+		std::size_t position = 0;
+		std::size_t filled = 0;
+		std::uint64_t remaining = 0;
+		void refill();
+	};
+
+	// takes terms in strictly descending exponent order into a new file;
+	// zero coefficients are dropped unless keep_zeros (intermediate runs,
+	// whose sums are not final yet)
+	class Writer {
+	public:
+		Writer(const DiskLimits &limits, std::size_t buffer_bytes, bool keep_zeros = false);
+		~Writer();
+		Writer(const Writer &) = delete;
+		Writer &operator=(const Writer &) = delete;
+
+		void append(double coefficient, std::int64_t exponent);
+		DiskPolynomial finish();
+
+	private:
+		std::shared_ptr<const File> file; // removes the file if never finished
+		std::ofstream out;
+		std::vector<Term> buffer;
+		std::uint64_t written = 0;
+		std::int64_t last = 0;
+		bool keep_zeros;
+		void flush();
+	};
+
+	DiskPolynomial() = default; // zero, without a file
+
+	// terms in descending exponent order, as in a snapshot
+	static DiskPolynomial fromSortedTerms(const Term *terms, std::size_t count, const DiskLimits &limits);
+	static DiskPolynomial fromCompact(const CompactPolynomial &poly, const DiskLimits &limits);
+	// throws if the terms need more than limits.memory_bytes
+	CompactPolynomial toCompact(const DiskLimits &limits) const;
+
+	// "n c1 e1 c2 e2 ...", as CompactPolynomial::read, in any order and of
+	// any length: sorted runs of the input are merged on disk
+	static DiskPolynomial read(std::istream &is, const DiskLimits &limits);
+	void print(std::ostream &os) const;
+
+	static DiskPolynomial add(const DiskPolynomial &a, const DiskPolynomial &b, const DiskLimits &limits);
+	static DiskPolynomial subtract(const DiskPolynomial &a, const DiskPolynomial &b, const DiskLimits &limits);
+	static DiskPolynomial multiply(const DiskPolynomial &a, const DiskPolynomial &b, const DiskLimits &limits);
+
+	double evaluate(double x) const;
+
+	std::uint64_t termCount() const { return count; }
+	std::uint64_t fileBytes() const { return count * sizeof(Term); }
+	std::string path() const; // empty without a file
+
+private:
+	std::shared_ptr<const File> file;
+	std::uint64_t count = 0;
+};
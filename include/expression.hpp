@@ -1,7 +1,19 @@
 #pragma once
 
-#include <string>
+#include "cancel.hpp"
+#include "stack.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+#include <cstddef>
 #include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+class ThreadPool;
 
 using i64 = long long;
 
@@ -9,21 +21,338 @@ struct Fraction {
     i64 numerator;
     i64 denominator;
 
-    Fraction(i64 num = 0, i64 denom = 1);
-    void normalize();
-
-    friend Fraction operator+(const Fraction &a, const Fraction &b);
-    Fraction& operator+=(const Fraction &other);
-    Fraction operator-() const;
-    friend Fraction operator-(const Fraction &a, const Fraction &b);
-    Fraction& operator-=(const Fraction &other);
-    friend Fraction operator*(const Fraction &a, const Fraction &b);
-    Fraction& operator*=(const Fraction &other);
-    friend Fraction operator/(const Fraction &a, const Fraction &b);
-    Fraction& operator/=(const Fraction &other);
-    friend Fraction operator^(const Fraction &base, int exponent);
-    Fraction& operator^=(int exponent);
+    constexpr Fraction(i64 num = 0, i64 denom = 1);
+    constexpr void normalize();
+
+    friend constexpr Fraction operator+(const Fraction &a, const Fraction &b);
+    constexpr Fraction& operator+=(const Fraction &other);
+    constexpr Fraction operator-() const;
+    friend constexpr Fraction operator-(const Fraction &a, const Fraction &b);
+    constexpr Fraction& operator-=(const Fraction &other);
+    friend constexpr Fraction operator*(const Fraction &a, const Fraction &b);
+    constexpr Fraction& operator*=(const Fraction &other);
+    friend constexpr Fraction operator/(const Fraction &a, const Fraction &b);
+    constexpr Fraction& operator/=(const Fraction &other);
+    friend constexpr Fraction operator^(const Fraction &base, int exponent);
+    constexpr Fraction& operator^=(int exponent);
+
+    friend constexpr bool operator==(const Fraction &a, const Fraction &b) = default;
 };
 
-Fraction expression_evaluate(const std::string &expr);
+// everything below is constexpr so that constant expressions fold at compile time,
+// e.g. constexpr Fraction k = "(20 + 2) * (6 / 2)"_frac;
+constexpr Fraction expression_evaluate(const std::string &expr);
+consteval Fraction operator""_frac(const char *text, std::size_t length);
 std::ostream& operator<<(std::ostream &os, const Fraction &value);
+
+// splits at top-level '+', '-', '*' and '/' and evaluates the operands on a
+// thread pool; the result (and any error) is exactly that of expression_evaluate
+Fraction expression_evaluate_parallel(const std::string &expr);
+Fraction expression_evaluate_parallel(const std::string &expr, ThreadPool &pool);
+
+constexpr Fraction::Fraction(i64 num, i64 denom) : numerator(num), denominator(denom) {
+    normalize();
+}
+
+constexpr void Fraction::normalize() {
+    if (denominator == 1) {
+        return; // integers are already reduced, skip the gcd
+    }
+    if (denominator < 0) {
+        denominator = -denominator;
+        numerator = -numerator;
+    }
+    if (!std::is_constant_evaluated()) {
+        CALC_STAT_ADD(GcdCalls, 1);
+    }
+    auto d = std::gcd(numerator, denominator);
+    numerator /= d;
+    denominator /= d;
+}
+
+constexpr Fraction operator+(const Fraction &a, const Fraction &b) {
+    return Fraction{a.numerator * b.denominator + b.numerator * a.denominator,
+                    a.denominator * b.denominator};
+}
+
+constexpr Fraction &Fraction::operator+=(const Fraction &other) {
+    *this = *this + other;
+    return *this;
+}
+
+constexpr Fraction Fraction::operator-() const {
+    return Fraction(-numerator, denominator);
+}
+
+constexpr Fraction operator-(const Fraction &a, const Fraction &b) {
+    return Fraction{a.numerator * b.denominator - b.numerator * a.denominator,
+                    a.denominator * b.denominator};
+}
+
+constexpr Fraction &Fraction::operator-=(const Fraction &other) {
+    *this = *this - other;
+    return *this;
+}
+
+constexpr Fraction operator*(const Fraction &a, const Fraction &b) {
+    return Fraction{a.numerator * b.numerator, a.denominator * b.denominator};
+}
+
+constexpr Fraction &Fraction::operator*=(const Fraction &other) {
+    *this = *this * other;
+    return *this;
+}
+
+constexpr Fraction operator/(const Fraction &a, const Fraction &b) {
+    if (b.numerator == 0) {
+        throw std::runtime_error("division by zero");
+    }
+    return Fraction{a.numerator * b.denominator, a.denominator * b.numerator};
+}
+
+constexpr Fraction &Fraction::operator/=(const Fraction &other) {
+    *this = *this / other;
+    return *this;
+}
+
+constexpr Fraction operator^(const Fraction &base, int exponent) {
+    if (exponent == 0) {
+        return Fraction(1, 1);
+    }
+    if (base.numerator == 0 && exponent < 0) {
+        throw std::runtime_error("zero cannot be raised to negative power");
+    }
+    Fraction result(1, 1);
+    Fraction factor = base;
+    if (exponent < 0) {
+        factor = Fraction(base.denominator, base.numerator);
+        exponent = -exponent;
+    }
+    while (exponent) {
+        if (exponent & 1) {
+            result *= factor;
+        }
+        if (exponent > 1) {
+            factor *= factor;
+        }
+        exponent >>= 1;
+    }
+    return result;
+}
+
+constexpr Fraction &Fraction::operator^=(int exponent) {
+    *this = (*this) ^ exponent;
+    return *this;
+}
+
+namespace expression_detail {
+
+// <cctype> is not constexpr, so the parser uses its own character classes
+constexpr bool is_space(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+constexpr bool is_digit(char ch) {
+    return ch >= '0' && ch <= '9';
+}
+
+constexpr std::string remove_spaces(const std::string &expr) {
+    std::string result;
+    result.reserve(expr.size());
+    for (const char &ch : expr) {
+        if (!is_space(ch)) {
+            result.push_back(ch);
+        }
+    }
+    return result;
+}
+
+constexpr int precedence(char op) {
+	switch (op) {
+	case '+':
+	case '-':
+		return 1;
+	case '*':
+	case '/':
+		return 2;
+	case '^':
+		return 3;
+	default:
+		throw std::runtime_error("unknown operator");
+	}
+}
+
+constexpr bool is_unary(char op, std::string_view input, std::size_t index) {
+    return (op == '+' || op == '-') && (index == 0 || input[index - 1] == '(' || input[index - 1] == '+' || input[index - 1] == '-' || input[index - 1] == '*' || input[index - 1] == '/' || input[index - 1] == '^');
+}
+
+constexpr bool is_right_associative(char op) {
+	return op == '^';
+}
+
+constexpr i64 parse_integer(std::string_view text, std::size_t &index) {
+    // parse a non-negative integer starting at text[index]
+    if (index >= text.size()) {
+        throw std::runtime_error("expected digit");
+    }
+    if (!is_digit(text[index])) {
+        throw std::runtime_error("expected digit");
+    }
+    i64 value = 0;
+    while (index < text.size() && is_digit(text[index])) {
+        value = value * 10 + (text[index] - '0');
+        ++index;
+    }
+    return value;
+}
+
+constexpr void apply_operator(Stack<Fraction> &values, char op) {
+    // apply operator op to the top two values on the stack
+    CALC_TRACE_SCOPE("apply_operator");
+	if (values.size() < 2) {
+		throw std::runtime_error("insufficient operands");
+	}
+	Fraction rhs = values.pop();
+	Fraction lhs = values.pop();
+	switch (op) {
+	case '+':
+		values.push(lhs + rhs);
+		break;
+	case '-':
+		values.push(lhs - rhs);
+		break;
+	case '*':
+		values.push(lhs * rhs);
+		break;
+	case '/':
+		values.push(lhs / rhs);
+		break;
+	case '^':
+		if (rhs.denominator != 1) {
+			throw std::runtime_error("exponent must be integer");
+		}
+		values.push(lhs ^ static_cast<int>(rhs.numerator));
+		break;
+	default:
+		throw std::runtime_error("unknown operator");
+	}
+}
+
+constexpr void process_operator(Stack<Fraction> &values, Stack<char> &operators, char op) {
+    // process operator op
+    CALC_TRACE_SCOPE("process_operator");
+	while (!operators.empty()) {
+		char top = operators.top();
+		if (top == '(') {
+			break;
+		}
+		int top_prec = precedence(top);
+		int op_prec = precedence(op);
+		if (top_prec > op_prec || (top_prec == op_prec && !is_right_associative(op))) {
+            // if top operator has higher or equal precedence, apply it first
+			operators.pop();
+			apply_operator(values, top);
+		} else {
+			break;
+		}
+	}
+	operators.push(op);
+}
+
+constexpr void collapse(Stack<Fraction> &values, Stack<char> &operators) {
+    // collapse until the matching '('
+	while (!operators.empty() && operators.top() != '(') {
+		char op = operators.pop();
+		apply_operator(values, op);
+	}
+	if (operators.empty()) {
+		throw std::runtime_error("missing opening parenthesis");
+	}
+	operators.pop();
+}
+
+// evaluates input without spaces on the given stacks, which are cleared
+// first; callers evaluating many operands reuse them instead of allocating
+constexpr Fraction evaluate_tokens(std::string_view input, Stack<Fraction> &values, Stack<char> &operators) {
+    values.clear();
+    operators.clear();
+
+    std::size_t index = 0;
+    while (index < input.size()) {
+        cancel::checkpoint();
+        char ch = input[index];
+
+        if (is_digit(ch)) {
+            Fraction number{parse_integer(input, index), 1};
+            values.push(number);
+            continue;
+        }
+
+        if (ch == '(') {
+            operators.push('(');
+            ++index;
+            continue;
+        } else if (ch == ')') {
+            ++index;
+            collapse(values, operators);
+            continue;
+        } else {
+            if (is_unary(ch, input, index)) {
+                int count = 0;
+                while (index < input.size() && (input[index] == '+' || input[index] == '-')) {
+                    if (input[index] == '-') {
+                        ++count;
+                    }
+                    if (index > 0 && (input[index - 1] == '*' || input[index - 1] == '/' || input[index - 1] == '^')) {
+                        throw std::runtime_error("invalid use of unary operator after '*', '/' or '^'");
+                    }
+                    ++index;
+                }
+                values.push(Fraction(0, 1));
+                ch = (count % 2 == 0) ? '+' : '-';
+                --index; // adjust for the upcoming ++index
+            }
+
+            process_operator(values, operators, ch);
+            ++index;
+        }
+    }
+
+    while (!operators.empty()) {
+        char op = operators.pop();
+        if (op == '(' || op == ')') {
+            throw std::runtime_error("mismatched parentheses");
+        }
+        apply_operator(values, op);
+    }
+
+    if (values.size() != 1) {
+        throw std::runtime_error("malformed expression");
+    }
+    return values.pop();
+}
+
+} // namespace expression_detail
+
+constexpr Fraction expression_evaluate(const std::string &expr) {
+    using namespace expression_detail;
+    CALC_TRACE_SCOPE("expression_evaluate");
+
+    std::string input;
+    {
+        CALC_TRACE_SCOPE("tokenize");
+        input = remove_spaces(expr);
+    }
+    if (input.empty()) {
+        throw std::runtime_error("expression is empty");
+    }
+
+    Stack<Fraction> values;
+    Stack<char> operators;
+    return evaluate_tokens(input, values, operators);
+}
+
+consteval Fraction operator""_frac(const char *text, std::size_t length) {
+    // a malformed literal throws during constant evaluation and fails the build
+    return expression_evaluate(std::string(text, length));
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// heap held by a value: what its data takes, and what the allocator adds on
+// top of that (chunk headers, rounding up to its size classes)
+struct MemoryUsage {
+	std::size_t bytes = 0;
+	std::size_t overhead = 0;
+
+	MemoryUsage &operator+=(const MemoryUsage &other) {
+		bytes += other.bytes;
+		overhead += other.overhead;
+		return *this;
+	}
+};
+
+// overhead of one live allocation of `requested` bytes from new or malloc.
+// glibc reports the usable size of the chunk, its header is one word;
+// elsewhere a header word and 16-byte rounding are assumed
+inline std::size_t allocation_overhead(const void *pointer, std::size_t requested) {
+#ifdef __GLIBC__
+	return malloc_usable_size(const_cast<void *>(pointer)) + sizeof(std::size_t) - requested;
+#else
+	(void)pointer;
+	return ((requested + sizeof(std::size_t) + 15) & ~std::size_t{15}) - requested;
+#endif
+}
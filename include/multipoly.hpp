@@ -0,0 +1,61 @@
+#pragma once
+
+#include "memory_usage.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// one term of a multivariate polynomial. The exponents of all variables are
+// packed into one word, 8 bits per variable with the variable listed first
+// in the most significant byte, so comparing two monomials is one integer
+// comparison (lexicographic order) and multiplying them is one addition.
+// the top bit of every byte is a guard: exponents stay below 128, the sum
+// of two exponents cannot carry into the next variable, and a guard bit set
+// after an addition reports the overflow.
+struct MultiTerm {
+	std::uint64_t monomial;
+	double coefficient;
+};
+
+struct MultiPolynomial {
+	static constexpr std::size_t MAX_VARIABLES = 8;
+	static constexpr unsigned MAX_EXPONENT = 127;
+
+	MultiPolynomial() = default;
+	// variables are single lowercase letters, e.g. "xyz"
+	explicit MultiPolynomial(std::string variables);
+
+	// "3x^2y - 2yz + 1.5"; the variables are the letters that occur
+	static MultiPolynomial parse(const std::string &text);
+	// terms in strictly descending monomial order over the given variables,
+	// as terms() returns them; zero coefficients are dropped
+	static MultiPolynomial fromSortedTerms(std::string variables, const MultiTerm *terms, std::size_t count);
+
+	friend MultiPolynomial operator+(const MultiPolynomial &a, const MultiPolynomial &b);
+	MultiPolynomial operator-() const;
+	friend MultiPolynomial operator-(const MultiPolynomial &a, const MultiPolynomial &b);
+	friend MultiPolynomial operator*(const MultiPolynomial &a, const MultiPolynomial &b);
+
+	// values[i] is substituted for variables()[i]
+	double evaluate(const std::vector<double> &values) const;
+	MultiPolynomial partialDerivative(char variable) const;
+	void addTerm(double coefficient, const std::vector<unsigned> &exponents);
+
+	// the same polynomial over a superset of its variables
+	MultiPolynomial withVariables(const std::string &variables) const;
+	const std::string &variables() const;
+	const std::vector<MultiTerm> &terms() const;
+	std::size_t termCount() const;
+	MemoryUsage memoryUsage() const; // the term array, with unused capacity
+	unsigned exponent(std::uint64_t monomial, std::size_t variable) const;
+
+	void print(std::ostream &os = std::cout) const;
+
+	private:
+	std::string vars;
+	std::vector<MultiTerm> list;
+	// terms in descending monomial order, no zero coefficients
+};
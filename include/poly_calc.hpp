@@ -0,0 +1,29 @@
+#pragma once
+
+#include "poly_store.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+struct PolyCalcStats {
+	std::size_t nodes = 0;      // distinct operations in the DAG
+	std::size_t reused = 0;     // subexpressions found again and shared
+	std::size_t fused = 0;      // additions folded into a k-way merge
+};
+
+// returns the polynomial of a name, or throws if there is none
+using PolyLookup = std::function<PolyHandle(const std::string &name)>;
+
+// evaluates an expression over the polynomials found by lookup:
+//   expr    := term (('+' | '-') term)*
+//   term    := unary ('*' unary)*
+//   unary   := '-' unary | postfix
+//   postfix := primary '\''*            (each ' is a derivative)
+//   primary := name | number | '(' expr ')'
+// the expression is parsed into a DAG with hash-consing, so a repeated
+// subexpression is computed once; chains of additions and subtractions are
+// evaluated as one merge, and intermediates are freed as soon as their last
+// consumer has run. Every name is looked up once, so the whole expression
+// sees one version of each polynomial
+Polynomial poly_calc(const std::string &expression, const PolyLookup &lookup, PolyCalcStats *stats = nullptr);
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "compact_poly.hpp"
+#include "disk_poly.hpp"
+#include "multipoly.hpp"
+#include "polynomial.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// named values shared by every session. Stored values are immutable; a
+// redefinition stores a new one and readers holding the old handle keep it
+// alive until they are done.
+//
+// names are spread over shards, each a map guarded by a shared_mutex.
+// A lookup holds its shard's lock shared just long enough to copy the
+// handle; writers lock one shard exclusively and change its map in place.
+// Readers still write the lock word, so lookups contend within a shard;
+// the shards keep that to names that hash alike. Old values are released
+// after the lock, so freeing a large one never stalls the shard.
+template <typename T>
+class NamedStore {
+public:
+    using Handle = std::shared_ptr<const T>;
+    using Entry = std::pair<std::string, Handle>;
+
+    NamedStore() = default;
+    NamedStore(const NamedStore &) = delete;
+    NamedStore &operator=(const NamedStore &) = delete;
+
+    Handle find(const std::string &name) const { // nullptr if absent
+        const Shard &shard = shard_for(name);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(name);
+        return it == shard.map.end() ? nullptr : it->second;
+    }
+
+    void put(const std::string &name, T value) {
+        // build the handle outside the lock, only the map update is serialized
+        Handle handle = std::make_shared<const T>(std::move(value));
+        Shard &shard = shard_for(name);
+        std::lock_guard<std::shared_mutex> lock(shard.mutex);
+        std::swap(shard.map[name], handle); // the old value goes with handle, after the lock
+    }
+
+    // stores all entries, one shard at a time
+    void put_all(std::vector<std::pair<std::string, T>> entries) {
+        std::array<std::vector<Entry>, SHARD_COUNT> grouped;
+        for (auto &[name, value] : entries) {
+            std::size_t index = shard_index(name);
+            grouped[index].emplace_back(std::move(name), std::make_shared<const T>(std::move(value)));
+        }
+        for (std::size_t i = 0; i < SHARD_COUNT; ++i) {
+            if (grouped[i].empty()) {
+                continue;
+            }
+            Shard &shard = shards_[i];
+            std::lock_guard<std::shared_mutex> lock(shard.mutex);
+            for (auto &[name, handle] : grouped[i]) {
+                std::swap(shard.map[name], handle);
+            }
+        } // grouped releases the old values, outside every lock
+    }
+
+    bool erase(const std::string &name) {
+        Handle old; // declared before the lock, so released after it
+        Shard &shard = shard_for(name);
+        std::lock_guard<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(name);
+        if (it == shard.map.end()) {
+            return false;
+        }
+        old = std::move(it->second);
+        shard.map.erase(it);
+        return true;
+    }
+
+    // stores value only while name still refers to expected, so a
+    // concurrent redefinition or erase is never undone
+    bool replace(const std::string &name, const Handle &expected, T value) {
+        Handle handle = std::make_shared<const T>(std::move(value));
+        Shard &shard = shard_for(name);
+        std::lock_guard<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(name);
+        if (it == shard.map.end() || it->second != expected) {
+            return false;
+        }
+        std::swap(it->second, handle);
+        return true;
+    }
+
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (const auto &shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            total += shard.map.size();
+        }
+        return total;
+    }
+
+    // consistent per shard, sorted by name
+    std::vector<Entry> entries() const {
+        std::vector<Entry> result;
+        for (const auto &shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            result.insert(result.end(), shard.map.begin(), shard.map.end());
+        }
+        std::sort(result.begin(), result.end(), [](const Entry &a, const Entry &b) { return a.first < b.first; });
+        return result;
+    }
+
+private:
+    using Map = std::unordered_map<std::string, Handle>;
+    static constexpr std::size_t SHARD_COUNT = 16;
+
+    // a cache line each, so the lock words of neighbouring shards do not
+    // bounce between cores
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        Map map;
+    };
+
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    static std::size_t shard_index(const std::string &name) {
+        return std::hash<std::string>{}(name) % SHARD_COUNT;
+    }
+    Shard &shard_for(const std::string &name) {
+        return shards_[shard_index(name)];
+    }
+    const Shard &shard_for(const std::string &name) const {
+        return shards_[shard_index(name)];
+    }
+};
+
+using PolyStore = NamedStore<Polynomial>;
+using PolyHandle = PolyStore::Handle;
+using PolyEntry = PolyStore::Entry;
+
+using MultiPolyStore = NamedStore<MultiPolynomial>;
+using MultiPolyHandle = MultiPolyStore::Handle;
+
+using CompactPolyStore = NamedStore<CompactPolynomial>;
+using CompactPolyHandle = CompactPolyStore::Handle;
+
+using DiskPolyStore = NamedStore<DiskPolynomial>;
+using DiskPolyHandle = DiskPolyStore::Handle;
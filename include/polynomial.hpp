@@ -1,11 +1,31 @@
 #pragma once
 
+#include "memory_usage.hpp"
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
 struct PolyTerm {
 	double coefficient;
 	int exponent;
 	PolyTerm *next;
 };
 
+// a root found by Polynomial::roots(). residual is the relative backward
+// error |P(z)| / sum |a_k||z|^k; the disc of radius error_bound around value
+// contains a root of P (an inclusion from the Weierstrass correction)
+struct PolyRoot {
+	std::complex<double> value;
+	double residual;
+	double error_bound;
+};
+
+class PreparedEvaluator;
+
 struct Polynomial {
 	Polynomial();
 	Polynomial(const Polynomial& other);
@@ -24,15 +44,70 @@ struct Polynomial {
 	Polynomial& operator*=(const Polynomial &other);
 
 	double evaluate(double x) const;
+	// the evaluator for the current terms, built on first use and kept until
+	// the polynomial changes; safe to call from several threads at once
+	const PreparedEvaluator &prepared() const;
 	Polynomial derivative() const;
 	void addTerm(double coefficient, int exponent);
+	// all complex roots with multiplicity, by Aberth-Ehrlich iteration;
+	// negative exponents are factored out, x = 0 is then never a root
+	std::vector<PolyRoot> roots() const;
+	// p(inner(x)) and p(x + a), by divide and conquer over dense products
+	// (FFT above a few dozen coefficients, so errors are relative to the
+	// largest coefficients); both reject negative exponents
+	Polynomial compose(const Polynomial &inner) const;
+	Polynomial shift(double a) const;
 
-	void print() const;
-	void printLaTeX() const;
+	// builds the list directly from terms in descending exponent order,
+	// without the sorted insertion addTerm performs
+	static Polynomial fromSortedTerms(const double *coefficients, const int *exponents, std::size_t count);
+	// sum of scales[i] * polys[i] in one k-way merge of the term lists,
+	// instead of k - 1 additions with their intermediate results
+	static Polynomial linearCombination(const std::vector<const Polynomial *> &polys, const std::vector<double> &scales);
+	const PolyTerm *terms() const;
+	std::size_t termCount() const;
+	// the nodes, their allocator overhead and a cached evaluator
+	MemoryUsage memoryUsage() const;
+	// a copy whose nodes sit in one contiguous block, in list order: one
+	// allocation instead of one per term, and walks over adjacent memory.
+	// the block is split into single nodes again before the terms change
+	Polynomial compacted() const;
+
+	void print(std::ostream &os = std::cout) const;
+	void printLaTeX(std::ostream &os = std::cout) const;
 
 	private:
 	PolyTerm *head;
 	// PolyTerms in descending order of exponent
+	PolyTerm *block = nullptr; // owns the nodes of a compacted polynomial
+	mutable std::atomic<const PreparedEvaluator *> evaluator{nullptr};
+	void before_change();
+};
+
+// single-point evaluation planned once for a polynomial. Terms closer than
+// a few exponents apart are laid out as dense segments, zeros filling the
+// gaps; a segment is evaluated by Estrin's scheme, whose dependency chain
+// grows with log n instead of Horner's n, and scaled by x^start taken from
+// repeated squares of x. The segments are independent and summed in
+// separate accumulators, so a sparse polynomial overlaps its powers as well
+class PreparedEvaluator {
+public:
+	explicit PreparedEvaluator(const Polynomial &poly);
+	double operator()(double x) const;
+	std::size_t segmentCount() const;
+	std::size_t memoryBytes() const {
+		return coefficients.capacity() * sizeof(double) + segments.capacity() * sizeof(Segment);
+	}
+
+private:
+	struct Segment {
+		int start;            // exponent of the first coefficient
+		std::uint32_t length; // a multiple of 4, or 1 for a lone term
+	};
+	std::vector<double> coefficients; // all segments in order, lowest first
+	std::vector<Segment> segments;
+	int squares = 0;                  // bits of the largest start
+	bool negative = false;            // some start is below zero
 };
 
-Polynomial createPoly();
+Polynomial createPoly(std::istream &is = std::cin);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// serves the calculator command language over a Unix domain socket.
+//   request:  one command line terminated by '\n'
+//   response: "OK <length>\n" or "ERR <length>\n", then <length> bytes of output
+// every connection is a session with its own CLIContext, all sessions share
+// the polynomial stores. Sessions are multiplexed by one poll() loop and
+// their commands run on a worker pool, in order within a session.
+// 'poly new' needs its terms on the same line.
+int run_server(const std::string &socket_path, std::size_t workers);
+void request_server_stop(); // async-signal-safe
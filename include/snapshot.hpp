@@ -0,0 +1,25 @@
+#pragma once
+
+#include "disk_poly.hpp"
+#include "poly_store.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// versioned binary snapshot of named polynomials:
+//   header | index (one entry per polynomial) | packed term arrays | names
+// each polynomial stores its coefficients (double) and exponents (int32) as
+// two contiguous arrays in descending exponent order, so a load maps the file
+// and builds the term lists straight from those arrays without parsing.
+// multivariate polynomials store their variable letters and packed terms;
+// compact ones and polynomials on disk store decoded (double, int64) term
+// records. Those on disk are copied through in buffers on save and back into
+// new term files on load, never held in memory whole.
+void save_snapshot(const std::string &path, const std::vector<PolyEntry> &polynomials,
+                   const std::vector<MultiPolyStore::Entry> &multipolys,
+                   const std::vector<CompactPolyStore::Entry> &compacts,
+                   const std::vector<DiskPolyStore::Entry> &disk_polynomials);
+// returns the number of polynomials loaded; existing names are replaced
+std::size_t load_snapshot(const std::string &path, PolyStore &store, MultiPolyStore &multi_store,
+                          CompactPolyStore &compact_store, DiskPolyStore &disk_store, const DiskLimits &limits);
@@ -1,25 +1,29 @@
 #pragma once
 
+#include "stats.hpp"
+
 #include <cstddef>
+#include <stdexcept>
+#include <type_traits>
 
 template <typename T>
 class Stack {
 public:
-    Stack();
-    explicit Stack(std::size_t initial_capacity); // initialize with given capacity
-    Stack(const Stack &other); // copy constructor
-    Stack(Stack &&other) noexcept; // move constructor
-    ~Stack();
-
-    Stack &operator=(const Stack &other);
-    Stack &operator=(Stack &&other) noexcept;
-
-    void push(const T &value);
-    T pop();
-    const T &top() const;
-    bool empty() const;
-    std::size_t size() const;
-    void clear();
+    constexpr Stack();
+    explicit constexpr Stack(std::size_t initial_capacity); // initialize with given capacity
+    constexpr Stack(const Stack &other); // copy constructor
+    constexpr Stack(Stack &&other) noexcept; // move constructor
+    constexpr ~Stack();
+
+    constexpr Stack &operator=(const Stack &other);
+    constexpr Stack &operator=(Stack &&other) noexcept;
+
+    constexpr void push(const T &value);
+    constexpr T pop();
+    constexpr const T &top() const;
+    constexpr bool empty() const;
+    constexpr std::size_t size() const;
+    constexpr void clear();
 
 private:
     static constexpr std::size_t DEFAULT_CAPACITY = 8;
@@ -28,5 +32,145 @@ private:
     std::size_t size_;
     std::size_t capacity_;
 
-    void ensure_capacity(std::size_t min_capacity);
+    constexpr void ensure_capacity(std::size_t min_capacity);
+    static constexpr T *allocate(std::size_t capacity);
 };
+
+template <typename T>
+constexpr T *Stack<T>::allocate(std::size_t capacity) {
+    if (capacity == 0) {
+        return nullptr;
+    }
+    return new T[capacity];
+}
+
+template <typename T>
+constexpr Stack<T>::Stack() : data_(nullptr), size_(0), capacity_(DEFAULT_CAPACITY) {
+    data_ = allocate(capacity_);
+}
+
+template <typename T>
+constexpr Stack<T>::Stack(std::size_t initial_capacity)
+    : data_(nullptr), size_(0), capacity_(initial_capacity == 0 ? DEFAULT_CAPACITY : initial_capacity) {
+    data_ = allocate(capacity_);
+}
+
+template <typename T>
+constexpr Stack<T>::Stack(const Stack &other) : data_(nullptr), size_(other.size_), capacity_(other.capacity_) {
+    // copy constructor
+    data_ = allocate(capacity_);
+    for (std::size_t i = 0; i < size_; ++i) {
+        data_[i] = other.data_[i];
+    }
+}
+
+template <typename T>
+constexpr Stack<T>::Stack(Stack &&other) noexcept : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+    // move constructor
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+}
+
+template <typename T>
+constexpr Stack<T>::~Stack() {
+    delete[] data_;
+    data_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+}
+
+template <typename T>
+constexpr Stack<T> &Stack<T>::operator=(const Stack &other) {
+    // copy
+    if (this == &other) {
+        return *this;
+    }
+    if (other.size_ > capacity_) {
+        delete[] data_;
+        capacity_ = other.capacity_;
+        if (capacity_ < other.size_) {
+            capacity_ = other.size_;
+        }
+        data_ = allocate(capacity_);
+    }
+    size_ = other.size_;
+    for (std::size_t i = 0; i < size_; ++i) {
+        data_[i] = other.data_[i];
+    }
+    return *this;
+}
+
+template <typename T>
+constexpr Stack<T> &Stack<T>::operator=(Stack &&other) noexcept {
+    // move
+    if (this == &other) {
+        return *this;
+    }
+    delete[] data_;
+    data_ = other.data_;
+    size_ = other.size_;
+    capacity_ = other.capacity_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+    return *this;
+}
+
+template <typename T>
+constexpr void Stack<T>::ensure_capacity(std::size_t min_capacity) {
+    if (capacity_ >= min_capacity) {
+        return;
+    }
+    std::size_t new_capacity = capacity_ == 0 ? DEFAULT_CAPACITY : capacity_;
+    while (new_capacity < min_capacity) {
+        new_capacity *= 2;
+    }
+    if (!std::is_constant_evaluated()) {
+        CALC_STAT_ADD(StackGrowths, 1);
+    }
+    T *new_data = allocate(new_capacity);
+    for (std::size_t i = 0; i < size_; ++i) {
+        new_data[i] = data_[i];
+    }
+    delete[] data_;
+    data_ = new_data;
+    capacity_ = new_capacity;
+}
+
+template <typename T>
+constexpr void Stack<T>::push(const T &value) {
+    ensure_capacity(size_ + 1);
+    data_[size_++] = value;
+}
+
+template <typename T>
+constexpr T Stack<T>::pop() {
+    if (size_ == 0) {
+        throw std::underflow_error("stack underflow");
+    }
+    return data_[--size_];
+}
+
+template <typename T>
+constexpr const T &Stack<T>::top() const {
+    if (size_ == 0) {
+        throw std::underflow_error("stack is empty");
+    }
+    return data_[size_ - 1];
+}
+
+template <typename T>
+constexpr bool Stack<T>::empty() const {
+    return size_ == 0;
+}
+
+template <typename T>
+constexpr std::size_t Stack<T>::size() const {
+    return size_;
+}
+
+template <typename T>
+constexpr void Stack<T>::clear() {
+    size_ = 0;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// hot-path counters and per-command latency histograms.
+// build with -DCALC_NO_STATS to compile every CALC_STAT_* site away.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace stats {
+
+enum class Counter : std::size_t {
+    GcdCalls,        // Fraction::normalize
+    StackGrowths,    // Stack reallocations
+    TermInserts,     // insert_term calls
+    TermAllocations, // PolyTerm nodes allocated
+    TermFrees,       // PolyTerm nodes freed
+    Count
+};
+
+constexpr std::size_t COUNTER_COUNT = static_cast<std::size_t>(Counter::Count);
+constexpr std::size_t LATENCY_BUCKETS = 40; // bucket i holds latencies below 2^i ns
+
+struct CommandLatency {
+    std::string command;
+    std::uint64_t count = 0;
+    std::uint64_t total_ns = 0;
+    std::uint64_t max_ns = 0;
+    std::array<std::uint64_t, LATENCY_BUCKETS> buckets{};
+
+    std::uint64_t percentile_ns(double fraction) const; // upper bound of the bucket
+};
+
+struct Snapshot {
+    std::array<std::uint64_t, COUNTER_COUNT> counters{};
+    std::vector<CommandLatency> commands;
+
+    std::uint64_t operator[](Counter counter) const {
+        return counters[static_cast<std::size_t>(counter)];
+    }
+};
+
+// every thread bumps its own cache line, snapshot() sums them up
+struct alignas(64) ThreadCounters {
+    std::array<std::atomic<std::uint64_t>, COUNTER_COUNT> values{};
+    bool registered = false;
+};
+
+// constinit lets the compiler access the block directly instead of going
+// through a TLS init wrapper on every increment
+extern constinit thread_local ThreadCounters thread_counters;
+void register_thread();
+
+inline void add(Counter counter, std::uint64_t amount = 1) {
+    if (!thread_counters.registered) {
+        register_thread();
+    }
+    // only this thread writes its counters (reset() moves a baseline instead
+    // of clearing them), so a load and a store need no locked instruction
+    auto &value = thread_counters.values[static_cast<std::size_t>(counter)];
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+const char *counter_name(Counter counter);
+void record_latency(const std::string &command, std::uint64_t nanoseconds);
+Snapshot snapshot();
+void reset();
+
+} // namespace stats
+
+#ifdef CALC_NO_STATS
+#define CALC_STATS_ENABLED 0
+#define CALC_STAT_ADD(counter, amount) ((void)0)
+#else
+#define CALC_STATS_ENABLED 1
+#define CALC_STAT_ADD(counter, amount) ::stats::add(::stats::Counter::counter, (amount))
+#endif
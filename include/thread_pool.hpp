@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing thread pool: every worker owns a deque, pops its own tasks
+// LIFO and steals from the front of the others' deques when it runs dry
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t threads = 0); // 0 = hardware concurrency
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+    bool run_pending(); // run one queued task on the calling thread, false if none
+    std::size_t size() const;
+
+    static ThreadPool &global();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> pending_;
+    std::atomic<std::size_t> next_queue_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+
+    bool try_pop(std::size_t self, std::function<void()> &task);
+    void worker_loop(std::size_t index);
+};
+
+// a set of tasks that can be waited on together; wait() helps to run
+// queued tasks instead of blocking, so nested groups cannot deadlock
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool &pool);
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+    ~TaskGroup();
+
+    void run(std::function<void()> task);
+    void wait(); // rethrows the first exception thrown by a task
+
+private:
+    ThreadPool &pool_;
+    std::atomic<std::size_t> outstanding_;
+    std::mutex error_mutex_;
+    std::exception_ptr error_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+// scoped tracing that writes Chrome / Perfetto trace-event JSON.
+// every thread appends to its own buffer, so recording takes no locks;
+// while tracing is off a scope costs one relaxed atomic load.
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace trace {
+
+inline constinit std::atomic<bool> enabled{false};
+
+std::uint64_t now_ns();
+void record(const char *name, std::uint64_t start_ns, std::uint64_t end_ns);
+const char *intern(const std::string &name); // stable pointer for runtime names
+
+void start(const std::string &path); // throws if tracing is already on
+void stop();                         // writes the file, throws on I/O errors
+bool active();
+
+class Scope {
+public:
+    constexpr explicit Scope(const char *name) : name_(nullptr), start_(0) {
+        if (!std::is_constant_evaluated() && enabled.load(std::memory_order_relaxed)) {
+            name_ = name;
+            start_ = now_ns();
+        }
+    }
+    constexpr ~Scope() {
+        if (!std::is_constant_evaluated() && name_) {
+            record(name_, start_, now_ns());
+        }
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *name_;
+    std::uint64_t start_;
+};
+
+} // namespace trace
+
+#define CALC_TRACE_JOIN_(a, b) a##b
+#define CALC_TRACE_JOIN(a, b) CALC_TRACE_JOIN_(a, b)
+#define CALC_TRACE_SCOPE(name) ::trace::Scope CALC_TRACE_JOIN(calc_trace_scope_, __LINE__){name}
@@ -0,0 +1,131 @@
+#include "cancel.hpp"
+
+#include <thread>
+
+namespace cancel {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// quiet commands never show progress; after that it is redrawn at this rate
+constexpr auto PROGRESS_DELAY = std::chrono::seconds(1);
+constexpr auto PROGRESS_INTERVAL = std::chrono::milliseconds(250);
+
+// written from the SIGINT handler, so it has to be lock-free
+std::atomic<bool> interrupted{false};
+static_assert(std::atomic<bool>::is_always_lock_free);
+
+const char *describe(Reason reason) {
+    switch (reason) {
+    case Reason::Interrupted:
+        return "interrupted";
+    case Reason::Timeout:
+        return "time limit exceeded";
+    case Reason::Memory:
+        return "memory budget exceeded";
+    }
+    return "cancelled";
+}
+
+} // namespace
+
+struct Token {
+    Limits limits;
+    bool interruptible = false;
+    ProgressSink progress;
+    std::thread::id owner = std::this_thread::get_id();
+    Clock::time_point started = Clock::now();
+    Clock::time_point deadline = started + limits.timeout;
+    Clock::time_point last_report{};
+    bool reported = false;
+    std::atomic<std::ptrdiff_t> bytes{0};
+    // the first reason is kept so that pool tasks of the same command stop
+    // at their next checkpoint as well; -1 while the command may go on
+    std::atomic<int> reason{-1};
+};
+
+constinit thread_local Token *current = nullptr;
+constinit thread_local std::ptrdiff_t unflushed_bytes = 0;
+
+Cancelled::Cancelled(Reason reason) : std::runtime_error(describe(reason)), reason_(reason) {}
+
+void interrupt() {
+    interrupted.store(true, std::memory_order_relaxed);
+}
+
+Scope::Scope(const Limits &limits, bool interruptible, ProgressSink progress)
+    : token_(new Token{limits, interruptible, std::move(progress)}), previous_(current) {
+    if (interruptible) {
+        interrupted.store(false, std::memory_order_relaxed); // a Ctrl-C at the prompt is not for us
+    }
+    unflushed_bytes = 0;
+    current = token_;
+}
+
+Scope::~Scope() {
+    if (token_->reported) {
+        try {
+            token_->progress(nullptr, 1.0);
+        } catch (...) {
+        }
+    }
+    current = previous_;
+    delete token_;
+}
+
+Adopt::Adopt(Token *token) : previous_(current) {
+    unflushed_bytes = 0;
+    current = token;
+}
+
+Adopt::~Adopt() {
+    if (current && unflushed_bytes != 0) {
+        current->bytes.fetch_add(unflushed_bytes, std::memory_order_relaxed);
+    }
+    unflushed_bytes = 0;
+    current = previous_;
+}
+
+void check() {
+    Token &token = *current;
+    if (unflushed_bytes != 0) {
+        token.bytes.fetch_add(unflushed_bytes, std::memory_order_relaxed);
+        unflushed_bytes = 0;
+    }
+    int reason = token.reason.load(std::memory_order_relaxed);
+    if (reason < 0) {
+        if (token.interruptible && interrupted.load(std::memory_order_relaxed)) {
+            reason = static_cast<int>(Reason::Interrupted);
+        } else if (token.limits.memory_bytes != 0
+                   && token.bytes.load(std::memory_order_relaxed) > static_cast<std::ptrdiff_t>(token.limits.memory_bytes)) {
+            reason = static_cast<int>(Reason::Memory);
+        } else if (token.limits.timeout.count() > 0 && Clock::now() > token.deadline) {
+            reason = static_cast<int>(Reason::Timeout);
+        } else {
+            return;
+        }
+        int expected = -1;
+        if (!token.reason.compare_exchange_strong(expected, reason)) {
+            reason = expected;
+        }
+    }
+    throw Cancelled(static_cast<Reason>(reason));
+}
+
+void report(const char *task, std::size_t done, std::size_t total) {
+    check();
+    Token &token = *current;
+    if (!token.progress || std::this_thread::get_id() != token.owner) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    if (now - token.started < PROGRESS_DELAY || (token.reported && now - token.last_report < PROGRESS_INTERVAL)) {
+        return;
+    }
+    token.reported = true;
+    token.last_report = now;
+    token.progress(task, total == 0 ? 0.0 : static_cast<double>(done) / static_cast<double>(total));
+}
+
+} // namespace cancel
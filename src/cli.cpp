@@ -0,0 +1,1103 @@
+#include "cli.hpp"
+#include "expression.hpp"
+#include "poly_calc.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace {
+
+std::string trim(std::string_view text) {
+    const auto begin = text.find_first_not_of(" \t\n\r");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    const auto end = text.find_last_not_of(" \t\n\r");
+    return std::string{text.substr(begin, end - begin + 1)};
+}
+
+std::pair<std::string, std::string> split_command(const std::string &line) {
+    std::string trimmed = trim(line);
+    if (trimmed.empty()) {
+        return {"", ""};
+    }
+    auto pos = trimmed.find_first_of(" \t");
+    if (pos == std::string::npos) {
+        std::string cmd = trimmed;
+        std::transform(cmd.begin(), cmd.end(), cmd.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return {cmd, ""};
+    }
+    std::string cmd = trimmed.substr(0, pos);
+    std::transform(cmd.begin(), cmd.end(), cmd.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    std::string rest = trim(trimmed.substr(pos + 1));
+    return {cmd, rest};
+}
+
+void print_fraction(std::ostream &out, const Fraction &value) {
+    long double approx = static_cast<long double>(value.numerator) / static_cast<long double>(value.denominator);
+    out << std::format("结果 = {}/{}   (≈ {:.15g})\n", value.numerator, value.denominator, approx);
+}
+
+// the handle keeps the polynomial alive even if another session redefines it
+PolyHandle require_polynomial(const CLIContext &ctx, const std::string &name) {
+    PolyHandle poly = ctx.polynomials->find(name);
+    if (!poly) {
+        throw std::runtime_error(std::format("未找到名为 '{}' 的多项式", name));
+    }
+    return poly;
+}
+
+void handle_expr_command(std::ostream &out, const std::string &payload) {
+    std::string expr = trim(payload);
+    bool parallel = false;
+    auto [flag, rest] = split_command(expr);
+    if (flag == "-p" || flag == "--parallel") {
+        parallel = true;
+        expr = rest;
+    }
+    if (expr.empty()) {
+        throw std::runtime_error("用法：expr [-p, --parallel] <expression>");
+    }
+    Fraction result = parallel ? expression_evaluate_parallel(expr) : expression_evaluate(expr);
+    print_fraction(out, result);
+}
+
+void handle_poly_new(CLIContext &ctx, const std::vector<std::string> &args, std::istream &in, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly new <name> [<n> <c1> <e1> ...]");
+    }
+    std::string name = args[1];
+    Polynomial poly;
+    if (args.size() > 2) {
+        // terms on the same line, as sent by scripts and server clients
+        std::string terms;
+        for (std::size_t i = 2; i < args.size(); ++i) {
+            terms += args[i] + ' ';
+        }
+        std::istringstream iss(terms);
+        poly = createPoly(iss);
+        if (!iss) {
+            throw std::runtime_error("多项式输入格式错误");
+        }
+    } else {
+        out << "输入项数量以及各项 (系数 指数)，例如：\n";
+        out << "3  2 2  -1 1  5 0\n表示 3 个项：2x^2 - 1x + 5\n> " << std::flush;
+        poly = createPoly(in);
+        bool ok = static_cast<bool>(in);
+        in.clear();
+        in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        if (!ok) {
+            throw std::runtime_error("多项式输入格式错误");
+        }
+    }
+    ctx.polynomials->put(name, std::move(poly));
+    out << std::format("多项式 '{}' 已保存。\n", name);
+}
+
+void handle_poly_list(const CLIContext &ctx, std::ostream &out) {
+    std::vector<PolyEntry> entries = ctx.polynomials->entries();
+    if (entries.empty() && ctx.multipolys->size() == 0 && ctx.compacts->size() == 0 && ctx.disks->size() == 0) {
+        out << "尚未保存任何多项式。\n";
+        return;
+    }
+    out << "已保存的多项式：\n";
+    for (const auto &entry : entries) {
+        out << "  • " << entry.first << '\n';
+    }
+    for (const auto &entry : ctx.multipolys->entries()) {
+        out << std::format("  • {} (多元：{})\n", entry.first, entry.second->variables());
+    }
+    for (const auto &entry : ctx.compacts->entries()) {
+        out << std::format("  • {} (紧凑：{} 项，{} 字节)\n", entry.first, entry.second->termCount(), entry.second->memoryBytes());
+    }
+    for (const auto &entry : ctx.disks->entries()) {
+        out << std::format("  • {} (磁盘：{} 项，{} 字节)\n", entry.first, entry.second->termCount(), entry.second->fileBytes());
+    }
+}
+
+void handle_poly_show(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly show <name> [-l, --latex]");
+    }
+    PolyHandle poly = require_polynomial(ctx, args[1]);
+    if (args.size() >= 3 && (args[2] == "-l" || args[2] == "--latex")) {
+        out << "  LaTeX 格式：";
+        poly->printLaTeX(out);
+    } else {
+        out << "  表达式：";
+        poly->print(out);
+    }
+}
+
+void handle_poly_eval(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error("用法：poly eval <name> <x>");
+    }
+    PolyHandle poly = require_polynomial(ctx, args[1]);
+    double x;
+    try {
+        x = std::stod(args[2]);
+    } catch (const std::exception &) {
+        throw std::runtime_error("x 必须是数字");
+    }
+    // stored polynomials never change: the evaluator built by the first
+    // eval serves every later one, from any session
+    double value = poly->prepared()(x);
+    out << std::format("P({}) = {:.10g}\n", x, value);
+}
+
+void handle_poly_deriv(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly deriv <name> [-l, --latex]");
+    }
+    PolyHandle poly = require_polynomial(ctx, args[1]);
+    Polynomial deriv = poly->derivative();
+    if (args.size() >= 3 && (args[2] == "-l" || args[2] == "--latex")) {
+        out << "  LaTeX 格式：";
+        deriv.printLaTeX(out);
+    } else {
+        out << "  表达式：";
+        deriv.print(out);
+    }
+}
+
+void print_result(const Polynomial &result, const std::vector<std::string> &args, std::size_t flag, std::ostream &out) {
+    if (args.size() > flag && (args[flag] == "-l" || args[flag] == "--latex")) {
+        result.printLaTeX(out);
+    } else {
+        result.print(out);
+    }
+}
+
+void handle_poly_compose(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error("用法：poly compose <P> <Q> [-l, --latex]，计算 P(Q(x))");
+    }
+    PolyHandle outer = require_polynomial(ctx, args[1]);
+    PolyHandle inner = require_polynomial(ctx, args[2]);
+    Polynomial result = outer->compose(*inner);
+    out << std::format("{}({}(x)) = ", args[1], args[2]);
+    print_result(result, args, 3, out);
+}
+
+void handle_poly_shift(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error("用法：poly shift <P> <a> [-l, --latex]，计算 P(x + a)");
+    }
+    PolyHandle poly = require_polynomial(ctx, args[1]);
+    double a;
+    try {
+        a = std::stod(args[2]);
+    } catch (const std::exception &) {
+        throw std::runtime_error("a 必须是数字");
+    }
+    Polynomial result = poly->shift(a);
+    out << std::format("{}(x + {}) = ", args[1], a);
+    print_result(result, args, 3, out);
+}
+
+std::string format_complex(std::complex<double> value, double error_bound) {
+    // roots whose inclusion disc reaches the real axis are printed as real
+    if (std::abs(value.imag()) <= error_bound) {
+        return std::format("{:.12g}", value.real());
+    }
+    return std::format("{:.12g} {} {:.12g}i", value.real(), value.imag() < 0 ? '-' : '+', std::abs(value.imag()));
+}
+
+void handle_poly_roots(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly roots <name>");
+    }
+    PolyHandle poly = require_polynomial(ctx, args[1]);
+    std::vector<PolyRoot> roots = poly->roots();
+    if (roots.empty()) {
+        out << "  多项式没有根。\n";
+        return;
+    }
+    double max_residual = 0.0;
+    double max_bound = 0.0;
+    for (const auto &root : roots) {
+        max_residual = std::max(max_residual, root.residual);
+        max_bound = std::max(max_bound, root.error_bound);
+    }
+    out << std::format("  共 {} 个根 (最大残差 {:.2e}，最大误差界 {:.2e})：\n", roots.size(), max_residual, max_bound);
+    for (std::size_t i = 0; i < roots.size(); ++i) {
+        out << std::format("  x{} = {}   (残差 {:.2e}，误差界 {:.2e})\n", i + 1,
+                           format_complex(roots[i].value, roots[i].error_bound), roots[i].residual, roots[i].error_bound);
+    }
+}
+
+Polynomial calculate_binary(const Polynomial &lhs, const Polynomial &rhs, const std::string &op) {
+    if (op == "add") {
+        return lhs + rhs;
+    }
+    if (op == "sub") {
+        return lhs - rhs;
+    }
+    if (op == "mul") {
+        return lhs * rhs;
+    }
+    throw std::runtime_error("不支持的运算");
+}
+
+void handle_poly_binary(const CLIContext &ctx, const std::vector<std::string> &args, const std::string &op, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error(std::format("用法：poly {} <A> <B> [-l, --latex]", op));
+    }
+    PolyHandle lhs = require_polynomial(ctx, args[1]);
+    PolyHandle rhs = require_polynomial(ctx, args[2]);
+    Polynomial result = calculate_binary(*lhs, *rhs, op);
+    out << std::format("{}({}, {}) = ", op, args[1], args[2]);
+    if (args.size() >= 4 && (args[3] == "-l" || args[3] == "--latex")) {
+        result.printLaTeX(out);
+    } else {
+        result.print(out);
+    }
+}
+
+void handle_poly_calc(CLIContext &ctx, const std::string &payload, std::ostream &out) {
+    // payload is "calc R = <expression>"; the expression keeps its spacing
+    std::string text = split_command(payload).second;
+    auto eq = text.find('=');
+    std::string name = eq == std::string::npos ? "" : trim(std::string_view(text).substr(0, eq));
+    if (name.empty() || name.find_first_of(" \t") != std::string::npos) {
+        throw std::runtime_error("用法：poly calc <R> = <expression>，例如 poly calc R = (p1 + p2) * p3' - p4");
+    }
+    PolyCalcStats calc_stats;
+    auto lookup = [&ctx](const std::string &operand) { return require_polynomial(ctx, operand); };
+    Polynomial result = poly_calc(text.substr(eq + 1), lookup, &calc_stats);
+    std::size_t terms = result.termCount();
+    ctx.polynomials->put(name, std::move(result));
+    out << std::format("多项式 '{}' 已保存 ({} 项；DAG {} 个节点，复用 {} 处，合并 {} 次加法)\n", name, terms,
+                       calc_stats.nodes, calc_stats.reused, calc_stats.fused);
+}
+
+MultiPolyHandle require_multipoly(const CLIContext &ctx, const std::string &name) {
+    MultiPolyHandle poly = ctx.multipolys->find(name);
+    if (!poly) {
+        throw std::runtime_error(std::format("未找到名为 '{}' 的多元多项式", name));
+    }
+    return poly;
+}
+
+void handle_poly_mnew(CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error("用法：poly mnew <name> <polynomial>，例如 poly mnew f 3x^2y - 2yz + 1");
+    }
+    std::string text;
+    for (std::size_t i = 2; i < args.size(); ++i) {
+        text += args[i] + ' ';
+    }
+    MultiPolynomial poly;
+    try {
+        poly = MultiPolynomial::parse(text);
+    } catch (const std::exception &e) {
+        throw std::runtime_error(std::format("多元多项式格式错误：{}", e.what()));
+    }
+    ctx.multipolys->put(args[1], std::move(poly));
+    out << std::format("多元多项式 '{}' 已保存。\n", args[1]);
+}
+
+void handle_poly_mshow(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly mshow <name>");
+    }
+    MultiPolyHandle poly = require_multipoly(ctx, args[1]);
+    out << "  表达式：";
+    poly->print(out);
+}
+
+void handle_poly_meval(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly meval <name> x=<value> y=<value> ...");
+    }
+    MultiPolyHandle poly = require_multipoly(ctx, args[1]);
+    const std::string &variables = poly->variables();
+    std::vector<double> values(variables.size());
+    std::vector<bool> given(variables.size(), false);
+    for (std::size_t i = 2; i < args.size(); ++i) {
+        const std::string &binding = args[i];
+        std::size_t position = binding.size() > 2 && binding[1] == '=' ? variables.find(binding[0]) : std::string::npos;
+        if (position == std::string::npos) {
+            throw std::runtime_error(std::format("无效的赋值 '{}'", binding));
+        }
+        try {
+            values[position] = std::stod(binding.substr(2));
+        } catch (const std::exception &) {
+            throw std::runtime_error(std::format("{} 的值必须是数字", binding[0]));
+        }
+        given[position] = true;
+    }
+    for (std::size_t v = 0; v < variables.size(); ++v) {
+        if (!given[v]) {
+            throw std::runtime_error(std::format("缺少变量 {} 的值", variables[v]));
+        }
+    }
+    std::string bindings;
+    for (std::size_t v = 0; v < variables.size(); ++v) {
+        bindings += std::format("{}{}={}", v ? ", " : "", variables[v], values[v]);
+    }
+    out << std::format("{}({}) = {:.10g}\n", args[1], bindings, poly->evaluate(values));
+}
+
+void handle_poly_mdiff(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3 || args[2].size() != 1) {
+        throw std::runtime_error("用法：poly mdiff <name> <variable>");
+    }
+    MultiPolyHandle poly = require_multipoly(ctx, args[1]);
+    MultiPolynomial deriv = poly->partialDerivative(args[2][0]);
+    out << std::format("  ∂{}/∂{} = ", args[1], args[2]);
+    deriv.print(out);
+}
+
+void handle_poly_mbinary(const CLIContext &ctx, const std::vector<std::string> &args, const std::string &op, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error(std::format("用法：poly {} <A> <B>", op));
+    }
+    MultiPolyHandle lhs = require_multipoly(ctx, args[1]);
+    MultiPolyHandle rhs = require_multipoly(ctx, args[2]);
+    MultiPolynomial result = op == "madd" ? *lhs + *rhs : op == "msub" ? *lhs - *rhs : *lhs * *rhs;
+    out << std::format("{}({}, {}) = ", op.substr(1), args[1], args[2]);
+    result.print(out);
+}
+
+CompactPolyHandle require_compact(const CLIContext &ctx, const std::string &name) {
+    CompactPolyHandle poly = ctx.compacts->find(name);
+    if (!poly) {
+        throw std::runtime_error(std::format("未找到名为 '{}' 的紧凑多项式", name));
+    }
+    return poly;
+}
+
+void handle_poly_snew(CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error("用法：poly snew <name> <n> <c1> <e1> ...，指数可达 64 位");
+    }
+    std::string terms;
+    for (std::size_t i = 2; i < args.size(); ++i) {
+        terms += args[i] + ' ';
+    }
+    std::istringstream iss(terms);
+    CompactPolynomial poly = CompactPolynomial::read(iss);
+    if (!iss) {
+        throw std::runtime_error("多项式输入格式错误");
+    }
+    std::size_t count = poly.termCount();
+    ctx.compacts->put(args[1], std::move(poly));
+    out << std::format("紧凑多项式 '{}' 已保存 ({} 项)。\n", args[1], count);
+}
+
+void handle_poly_pack(CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly pack <name>");
+    }
+    PolyHandle poly = require_polynomial(ctx, args[1]);
+    CompactPolynomial packed(*poly);
+    std::size_t terms = packed.termCount();
+    std::size_t list_bytes = terms * sizeof(PolyTerm);
+    std::size_t packed_bytes = packed.memoryBytes();
+    ctx.compacts->put(args[1], std::move(packed));
+    out << std::format("紧凑多项式 '{}' 已保存：{} 项，链表 {} 字节 (不含分配器开销) → 紧凑 {} 字节\n", args[1], terms,
+                       list_bytes, packed_bytes);
+}
+
+void handle_poly_sshow(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly sshow <name>");
+    }
+    CompactPolyHandle poly = require_compact(ctx, args[1]);
+    out << std::format("  {} 项，{} 字节\n  表达式：", poly->termCount(), poly->memoryBytes());
+    poly->print(out);
+}
+
+void handle_poly_seval(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error("用法：poly seval <name> <x>");
+    }
+    CompactPolyHandle poly = require_compact(ctx, args[1]);
+    double x;
+    try {
+        x = std::stod(args[2]);
+    } catch (const std::exception &) {
+        throw std::runtime_error("x 必须是数字");
+    }
+    out << std::format("P({}) = {:.10g}\n", x, poly->evaluate(x));
+}
+
+void handle_poly_sdiff(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly sdiff <name>");
+    }
+    CompactPolyHandle poly = require_compact(ctx, args[1]);
+    // computed first, so an exponent overflow leaves no half-printed line
+    CompactPolynomial deriv = poly->derivative();
+    out << "  表达式：";
+    deriv.print(out);
+}
+
+void handle_poly_sbinary(const CLIContext &ctx, const std::vector<std::string> &args, const std::string &op, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error(std::format("用法：poly {} <A> <B>", op));
+    }
+    CompactPolyHandle lhs = require_compact(ctx, args[1]);
+    CompactPolyHandle rhs = require_compact(ctx, args[2]);
+    CompactPolynomial result = op == "sadd" ? *lhs + *rhs : op == "ssub" ? *lhs - *rhs : *lhs * *rhs;
+    out << std::format("{}({}, {}) = ", op.substr(1), args[1], args[2]);
+    result.print(out);
+}
+
+DiskPolyHandle require_disk(const CLIContext &ctx, const std::string &name) {
+    DiskPolyHandle poly = ctx.disks->find(name);
+    if (!poly) {
+        throw std::runtime_error(std::format("未找到名为 '{}' 的磁盘多项式", name));
+    }
+    return poly;
+}
+
+void handle_poly_dimport(CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error("用法：poly dimport <name> <file>，文件内容为 n c1 e1 c2 e2 ...");
+    }
+    std::ifstream file(args[2]);
+    if (!file) {
+        throw std::runtime_error(std::format("无法打开文件 '{}'", args[2]));
+    }
+    DiskPolynomial poly = DiskPolynomial::read(file, ctx.disk);
+    if (file.fail()) {
+        throw std::runtime_error("多项式输入格式错误");
+    }
+    std::uint64_t count = poly.termCount();
+    ctx.disks->put(args[1], std::move(poly));
+    out << std::format("磁盘多项式 '{}' 已导入 ({} 项)。\n", args[1], count);
+}
+
+void handle_poly_dexport(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error("用法：poly dexport <name> <file>");
+    }
+    DiskPolyHandle poly = require_disk(ctx, args[1]);
+    std::ofstream file(args[2], std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error(std::format("无法创建文件 '{}'", args[2]));
+    }
+    poly->print(file);
+    if (!file) {
+        throw std::runtime_error(std::format("写入文件 '{}' 失败", args[2]));
+    }
+    out << std::format("已导出 {} 项到 '{}'。\n", poly->termCount(), args[2]);
+}
+
+void handle_poly_spill(CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly spill <name>");
+    }
+    // the compact form is taken if both exist, it holds 64-bit exponents
+    DiskPolynomial poly;
+    if (CompactPolyHandle compact = ctx.compacts->find(args[1])) {
+        poly = DiskPolynomial::fromCompact(*compact, ctx.disk);
+    } else {
+        poly = DiskPolynomial::fromCompact(CompactPolynomial(*require_polynomial(ctx, args[1])), ctx.disk);
+    }
+    std::uint64_t count = poly.termCount();
+    ctx.disks->put(args[1], std::move(poly));
+    out << std::format("磁盘多项式 '{}' 已保存 ({} 项)。\n", args[1], count);
+}
+
+void handle_poly_fetch(CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly fetch <name>");
+    }
+    DiskPolyHandle poly = require_disk(ctx, args[1]);
+    CompactPolynomial compact = poly->toCompact(ctx.disk);
+    std::size_t count = compact.termCount();
+    ctx.compacts->put(args[1], std::move(compact));
+    out << std::format("紧凑多项式 '{}' 已保存 ({} 项)。\n", args[1], count);
+}
+
+void handle_poly_dshow(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly dshow <name> [项数]");
+    }
+    DiskPolyHandle poly = require_disk(ctx, args[1]);
+    std::size_t limit = 10;
+    if (args.size() >= 3) {
+        try {
+            limit = std::stoul(args[2]);
+        } catch (const std::exception &) {
+            throw std::runtime_error("项数必须是非负整数");
+        }
+    }
+    out << std::format("  {} 项，文件 {} 字节 ({})\n  最高次的项：", poly->termCount(), poly->fileBytes(), poly->path());
+    std::size_t shown = 0;
+    for (DiskPolynomial::Reader reader(*poly, limit * sizeof(DiskPolynomial::Term)); !reader.done() && shown < limit; reader.next()) {
+        out << std::format(" {} {}", reader.term().coefficient, reader.term().exponent);
+        ++shown;
+    }
+    out << (shown < poly->termCount() ? " ...\n" : "\n");
+}
+
+void handle_poly_deval(const CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 3) {
+        throw std::runtime_error("用法：poly deval <name> <x>");
+    }
+    DiskPolyHandle poly = require_disk(ctx, args[1]);
+    double x;
+    try {
+        x = std::stod(args[2]);
+    } catch (const std::exception &) {
+        throw std::runtime_error("x 必须是数字");
+    }
+    out << std::format("P({}) = {:.10g}\n", x, poly->evaluate(x));
+}
+
+void handle_poly_dbinary(CLIContext &ctx, const std::vector<std::string> &args, const std::string &op, std::ostream &out) {
+    // results on disk are too large to print, they are stored under R
+    if (args.size() < 4) {
+        throw std::runtime_error(std::format("用法：poly {} <R> <A> <B>", op));
+    }
+    DiskPolyHandle lhs = require_disk(ctx, args[2]);
+    DiskPolyHandle rhs = require_disk(ctx, args[3]);
+    DiskPolynomial result = op == "dadd"   ? DiskPolynomial::add(*lhs, *rhs, ctx.disk)
+                            : op == "dsub" ? DiskPolynomial::subtract(*lhs, *rhs, ctx.disk)
+                                           : DiskPolynomial::multiply(*lhs, *rhs, ctx.disk);
+    std::uint64_t count = result.termCount();
+    std::uint64_t bytes = result.fileBytes();
+    ctx.disks->put(args[1], std::move(result));
+    out << std::format("磁盘多项式 '{}' 已保存 ({} 项，{} 字节)。\n", args[1], count, bytes);
+}
+
+void handle_poly_drop(CLIContext &ctx, const std::vector<std::string> &args, std::ostream &out) {
+    if (args.size() < 2) {
+        throw std::runtime_error("用法：poly drop <name>");
+    }
+    // a name may be held in several forms (poly spill keeps the original)
+    bool dropped = ctx.polynomials->erase(args[1]);
+    dropped = ctx.multipolys->erase(args[1]) || dropped;
+    dropped = ctx.compacts->erase(args[1]) || dropped;
+    dropped = ctx.disks->erase(args[1]) || dropped;
+    if (!dropped) {
+        throw std::runtime_error(std::format("未找到名为 '{}' 的多项式", args[1]));
+    }
+    out << std::format("多项式 '{}' 已删除。\n", args[1]);
+}
+
+void handle_save_command(const CLIContext &ctx, const std::string &payload, std::ostream &out) {
+    std::string path = trim(payload);
+    if (path.empty()) {
+        throw std::runtime_error("用法：save <file>");
+    }
+    std::vector<PolyEntry> entries = ctx.polynomials->entries();
+    std::vector<MultiPolyStore::Entry> multi_entries = ctx.multipolys->entries();
+    std::vector<CompactPolyStore::Entry> compact_entries = ctx.compacts->entries();
+    std::vector<DiskPolyStore::Entry> disk_entries = ctx.disks->entries();
+    save_snapshot(path, entries, multi_entries, compact_entries, disk_entries);
+    std::size_t count = entries.size() + multi_entries.size() + compact_entries.size() + disk_entries.size();
+    out << std::format("已保存 {} 个多项式到 '{}'。\n", count, path);
+}
+
+void handle_load_command(CLIContext &ctx, const std::string &payload, std::ostream &out) {
+    std::string path = trim(payload);
+    if (path.empty()) {
+        throw std::runtime_error("用法：load <file>");
+    }
+    std::size_t count = load_snapshot(path, *ctx.polynomials, *ctx.multipolys, *ctx.compacts, *ctx.disks, ctx.disk);
+    out << std::format("已从 '{}' 载入 {} 个多项式。\n", path, count);
+}
+
+// resident set of the process, 0 where it cannot be read
+std::size_t resident_bytes() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    std::size_t total = 0;
+    std::size_t resident = 0;
+    if (statm >> total >> resident) {
+        return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+MemoryUsage store_usage(const CLIContext &ctx) {
+    MemoryUsage total;
+    for (const auto &entry : ctx.polynomials->entries()) {
+        total += entry.second->memoryUsage();
+    }
+    for (const auto &entry : ctx.multipolys->entries()) {
+        total += entry.second->memoryUsage();
+    }
+    for (const auto &entry : ctx.compacts->entries()) {
+        total += entry.second->memoryUsage();
+    }
+    return total;
+}
+
+void handle_mem_command(const CLIContext &ctx, std::ostream &out) {
+    std::size_t terms = 0;
+    MemoryUsage total;
+    std::uint64_t file_bytes = 0;
+    out << "内存占用：\n";
+    auto line = [&](const std::string &name, const char *kind, std::size_t count, const MemoryUsage &usage) {
+        out << std::format("  • {} ({}{} 项，{} 字节，分配器开销 {} 字节)\n", name, kind, count, usage.bytes, usage.overhead);
+        terms += count;
+        total += usage;
+    };
+    for (const auto &entry : ctx.polynomials->entries()) {
+        line(entry.first, "", entry.second->termCount(), entry.second->memoryUsage());
+    }
+    for (const auto &entry : ctx.multipolys->entries()) {
+        line(entry.first, "多元：", entry.second->termCount(), entry.second->memoryUsage());
+    }
+    for (const auto &entry : ctx.compacts->entries()) {
+        line(entry.first, "紧凑：", entry.second->termCount(), entry.second->memoryUsage());
+    }
+    for (const auto &entry : ctx.disks->entries()) {
+        // only the handle is in memory, the terms are in the file
+        out << std::format("  • {} (磁盘：{} 项，文件 {} 字节)\n", entry.first, entry.second->termCount(), entry.second->fileBytes());
+        file_bytes += entry.second->fileBytes();
+    }
+    out << std::format("合计：{} 项，{} 字节，分配器开销 {} 字节", terms, total.bytes, total.overhead);
+    if (file_bytes > 0) {
+        out << std::format("，磁盘文件 {} 字节", file_bytes);
+    }
+    out << '\n';
+    if (std::size_t resident = resident_bytes()) {
+        out << std::format("进程常驻内存：{} 字节\n", resident);
+    }
+}
+
+// copies every polynomial into tight storage (one block of nodes per list,
+// vectors without spare capacity) and hands the freed pages back to the
+// system. Readers holding the old values keep them until they are done
+void handle_compact_command(CLIContext &ctx, std::ostream &out) {
+    MemoryUsage before = store_usage(ctx);
+    std::size_t resident_before = resident_bytes();
+    std::size_t count = 0;
+    for (auto &entry : ctx.polynomials->entries()) {
+        count += ctx.polynomials->replace(entry.first, entry.second, entry.second->compacted());
+    }
+    for (auto &entry : ctx.multipolys->entries()) {
+        count += ctx.multipolys->replace(entry.first, entry.second, MultiPolynomial(*entry.second));
+    }
+    for (auto &entry : ctx.compacts->entries()) {
+        count += ctx.compacts->replace(entry.first, entry.second, CompactPolynomial(*entry.second));
+    }
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    MemoryUsage after = store_usage(ctx);
+    out << std::format("已整理 {} 个多项式：{} → {} 字节，分配器开销 {} → {} 字节。\n", count, before.bytes,
+                       after.bytes, before.overhead, after.overhead);
+    if (std::size_t resident = resident_bytes()) {
+        out << std::format("进程常驻内存：{} → {} 字节\n", resident_before, resident);
+    }
+}
+
+void handle_stats_command(const std::string &payload, std::ostream &out) {
+#if CALC_STATS_ENABLED
+    std::string sub = trim(payload);
+    if (sub == "reset") {
+        stats::reset();
+        out << "统计数据已清零。\n";
+        return;
+    }
+    if (!sub.empty()) {
+        throw std::runtime_error("用法：stats [reset]");
+    }
+    stats::Snapshot snap = stats::snapshot();
+    out << "计数器：\n";
+    for (std::size_t i = 0; i < stats::COUNTER_COUNT; ++i) {
+        auto counter = static_cast<stats::Counter>(i);
+        out << std::format("  {:<20}{}\n", stats::counter_name(counter), snap[counter]);
+    }
+    if (snap.commands.empty()) {
+        return;
+    }
+    out << "命令延迟 (μs)：\n";
+    out << std::format("  {:<16}{:>8}{:>12}{:>12}{:>12}{:>12}\n", "command", "count", "mean", "p50", "p99", "max");
+    for (const auto &entry : snap.commands) {
+        out << std::format("  {:<16}{:>8}{:>12.1f}{:>12.1f}{:>12.1f}{:>12.1f}\n", entry.command, entry.count,
+                           static_cast<double>(entry.total_ns) / static_cast<double>(entry.count) / 1e3,
+                           static_cast<double>(entry.percentile_ns(0.5)) / 1e3,
+                           static_cast<double>(entry.percentile_ns(0.99)) / 1e3,
+                           static_cast<double>(entry.max_ns) / 1e3);
+    }
+#else
+    (void)payload;
+    out << "性能统计在编译时被禁用 (CALC_NO_STATS)。\n";
+#endif
+}
+
+void handle_trace_command(const std::string &payload, std::ostream &out) {
+    auto [sub, path] = split_command(payload);
+    if (sub == "on" && !path.empty()) {
+        trace::start(path);
+        out << std::format("开始记录 trace，输出到 '{}'。\n", path);
+    } else if (sub == "off") {
+        if (!trace::active()) {
+            throw std::runtime_error("trace 尚未开启");
+        }
+        trace::stop();
+        out << "trace 已写出。\n";
+    } else {
+        throw std::runtime_error("用法：trace on <file> | trace off");
+    }
+}
+
+std::chrono::milliseconds parse_duration(const std::string &text) {
+    // "5s", "250ms", "2m"; a bare number is seconds, "off" or 0 lifts the limit
+    if (text == "off") {
+        return std::chrono::milliseconds(0);
+    }
+    char *end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    std::string unit = end ? std::string(end) : "";
+    double scale = unit == "ms" ? 1.0 : unit == "s" || unit.empty() ? 1e3 : unit == "m" ? 6e4 : -1.0;
+    if (end == text.c_str() || !(value >= 0.0) || scale < 0.0 || value * scale > 1e12) {
+        throw std::runtime_error(std::format("无效的时长：{}，例如 5s、250ms、2m 或 off", text));
+    }
+    return std::chrono::milliseconds(static_cast<long long>(std::ceil(value * scale)));
+}
+
+std::size_t parse_bytes(const std::string &text) {
+    // "512M", "2G", "64KiB"; a bare number is bytes, "off" or 0 lifts the budget
+    if (text == "off") {
+        return 0;
+    }
+    char *end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    std::string unit = end ? std::string(end) : "";
+    std::transform(unit.begin(), unit.end(), unit.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    if (unit.size() > 1 && unit.back() == 'B') {
+        unit.pop_back();
+        if (unit.size() > 1 && unit.back() == 'I') {
+            unit.pop_back();
+        }
+    }
+    double scale = unit.empty() ? 1.0 : unit == "K" ? 0x1p10 : unit == "M" ? 0x1p20 : unit == "G" ? 0x1p30 : -1.0;
+    if (end == text.c_str() || !(value >= 0.0) || scale < 0.0 || value * scale > 0x1p50) {
+        throw std::runtime_error(std::format("无效的内存大小：{}，例如 64K、512M、2G 或 off", text));
+    }
+    return static_cast<std::size_t>(value * scale);
+}
+
+std::string format_duration(std::chrono::milliseconds duration) {
+    if (duration.count() == 0) {
+        return "不限";
+    }
+    if (duration.count() % 1000 == 0) {
+        return std::format("{}s", duration.count() / 1000);
+    }
+    return std::format("{}ms", duration.count());
+}
+
+std::string format_bytes(std::size_t bytes) {
+    if (bytes == 0) {
+        return "不限";
+    }
+    const char *units[] = {"B", "KiB", "MiB", "GiB"};
+    std::size_t unit = 0;
+    while (unit + 1 < std::size(units) && bytes % 1024 == 0) {
+        bytes /= 1024;
+        ++unit;
+    }
+    return std::format("{}{}", bytes, units[unit]);
+}
+
+void handle_set_command(CLIContext &ctx, const std::string &payload, std::ostream &out) {
+    auto [key, value] = split_command(payload);
+    if (key.empty()) {
+        out << std::format("  timeout = {}\n  memory = {}\n  progress = {}\n  workmem = {}\n  tmpdir = {}\n",
+                           format_duration(ctx.limits.timeout), format_bytes(ctx.limits.memory_bytes),
+                           ctx.show_progress ? "on" : "off", format_bytes(ctx.disk.memory_bytes),
+                           ctx.disk.directory.empty() ? "(系统临时目录)" : ctx.disk.directory);
+        return;
+    }
+    if (key == "timeout" && !value.empty()) {
+        ctx.limits.timeout = parse_duration(value);
+        out << std::format("每条命令的时间上限：{}\n", format_duration(ctx.limits.timeout));
+    } else if (key == "memory" && !value.empty()) {
+        ctx.limits.memory_bytes = parse_bytes(value);
+        out << std::format("每条命令的内存预算：{}\n", format_bytes(ctx.limits.memory_bytes));
+    } else if (key == "progress" && (value == "on" || value == "off")) {
+        ctx.show_progress = value == "on";
+        out << std::format("进度显示：{}\n", value);
+    } else if (key == "workmem" && !value.empty()) {
+        // below a few buffers the merges would only get deeper
+        std::size_t bytes = parse_bytes(value);
+        if (bytes < (std::size_t{1} << 20)) {
+            throw std::runtime_error("磁盘运算的工作内存至少为 1M");
+        }
+        ctx.disk.memory_bytes = bytes;
+        out << std::format("磁盘运算的工作内存：{}\n", format_bytes(bytes));
+    } else if (key == "tmpdir" && !value.empty()) {
+        ctx.disk.directory = value == "default" ? "" : value;
+        out << std::format("磁盘多项式的文件目录：{}\n", ctx.disk.directory.empty() ? "(系统临时目录)" : value);
+    } else {
+        throw std::runtime_error("用法：set [timeout <5s|off> | memory <512M|off> | progress <on|off> | workmem <64M> | "
+                                 "tmpdir <dir|default>]");
+    }
+}
+
+std::string describe_cancel(const CLIContext &ctx, cancel::Reason reason) {
+    switch (reason) {
+    case cancel::Reason::Interrupted:
+        return "命令已中断";
+    case cancel::Reason::Timeout:
+        return std::format("命令超时 (限制 {})", format_duration(ctx.limits.timeout));
+    case cancel::Reason::Memory:
+        return std::format("命令超出内存预算 (限制 {})", format_bytes(ctx.limits.memory_bytes));
+    }
+    return "命令已取消";
+}
+
+cancel::ProgressSink progress_sink(const CLIContext &ctx) {
+    if (!ctx.progress || !ctx.show_progress) {
+        return {};
+    }
+    std::ostream *out = ctx.progress;
+    return [out](const char *task, double fraction) {
+        if (task) {
+            *out << std::format("\r  [{}] {:3.0f}%", task, fraction * 100.0) << std::flush;
+        } else {
+            *out << "\r" << std::string(32, ' ') << "\r" << std::flush;
+        }
+    };
+}
+
+void split_args(const std::string &payload, std::vector<std::string> &args) {
+    std::istringstream iss(payload);
+    std::string token;
+    while (iss >> token) {
+        args.push_back(token);
+    }
+}
+
+void handle_poly_command(CLIContext &ctx, const std::string &payload, std::istream &in, std::ostream &out) {
+    std::vector<std::string> args;
+    split_args(payload, args);
+    if (args.empty()) {
+        throw std::runtime_error("用法：poly <subcommand> ...，输入 help 查看详情");
+    }
+    std::string sub = args[0];
+    std::transform(sub.begin(), sub.end(), sub.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (sub == "new") {
+        handle_poly_new(ctx, args, in, out);
+    } else if (sub == "list") {
+        handle_poly_list(ctx, out);
+    } else if (sub == "show") {
+        handle_poly_show(ctx, args, out);
+    } else if (sub == "eval") {
+        handle_poly_eval(ctx, args, out);
+    } else if (sub == "deriv" || sub == "diff") {
+        handle_poly_deriv(ctx, args, out);
+    } else if (sub == "roots") {
+        handle_poly_roots(ctx, args, out);
+    } else if (sub == "compose") {
+        handle_poly_compose(ctx, args, out);
+    } else if (sub == "shift") {
+        handle_poly_shift(ctx, args, out);
+    } else if (sub == "add" || sub == "sub" || sub == "mul") {
+        handle_poly_binary(ctx, args, sub, out);
+    } else if (sub == "calc") {
+        handle_poly_calc(ctx, payload, out);
+    } else if (sub == "mnew") {
+        handle_poly_mnew(ctx, args, out);
+    } else if (sub == "mshow") {
+        handle_poly_mshow(ctx, args, out);
+    } else if (sub == "meval") {
+        handle_poly_meval(ctx, args, out);
+    } else if (sub == "mdiff") {
+        handle_poly_mdiff(ctx, args, out);
+    } else if (sub == "madd" || sub == "msub" || sub == "mmul") {
+        handle_poly_mbinary(ctx, args, sub, out);
+    } else if (sub == "snew") {
+        handle_poly_snew(ctx, args, out);
+    } else if (sub == "pack") {
+        handle_poly_pack(ctx, args, out);
+    } else if (sub == "sshow") {
+        handle_poly_sshow(ctx, args, out);
+    } else if (sub == "seval") {
+        handle_poly_seval(ctx, args, out);
+    } else if (sub == "sdiff") {
+        handle_poly_sdiff(ctx, args, out);
+    } else if (sub == "sadd" || sub == "ssub" || sub == "smul") {
+        handle_poly_sbinary(ctx, args, sub, out);
+    } else if (sub == "dimport") {
+        handle_poly_dimport(ctx, args, out);
+    } else if (sub == "dexport") {
+        handle_poly_dexport(ctx, args, out);
+    } else if (sub == "spill") {
+        handle_poly_spill(ctx, args, out);
+    } else if (sub == "fetch") {
+        handle_poly_fetch(ctx, args, out);
+    } else if (sub == "dshow") {
+        handle_poly_dshow(ctx, args, out);
+    } else if (sub == "deval") {
+        handle_poly_deval(ctx, args, out);
+    } else if (sub == "dadd" || sub == "dsub" || sub == "dmul") {
+        handle_poly_dbinary(ctx, args, sub, out);
+    } else if (sub == "drop") {
+        handle_poly_drop(ctx, args, out);
+    } else {
+        throw std::runtime_error(std::format("未知的 poly 子命令：{}", sub));
+    }
+}
+
+} // namespace
+
+void print_banner(std::ostream &out) {
+    const char *banner =
+        "\n"
+        "╔════════════════════════════════════════════════╗\n"
+        "║            Polynomial & Expression             ║\n"
+        "║                Calculator CLI                  ║\n"
+        "╚════════════════════════════════════════════════╝\n";
+    out << banner;
+}
+
+void print_help(std::ostream &out) {
+    constexpr int COL_WIDTH = 28;
+    out << "可用命令：\n";
+    out << std::left
+        << std::setw(COL_WIDTH) << "  help" << "显示帮助" << '\n'
+        << std::setw(COL_WIDTH) << "  expr <expression>" << "计算分式四则表达式" << '\n'
+        << std::setw(COL_WIDTH) << "  expr -p <expression>" << "多线程计算超长表达式" << '\n'
+        << std::setw(COL_WIDTH) << "  poly new <name> [terms]" << "创建多项式 (省略项时交互输入)" << '\n'
+        << std::setw(COL_WIDTH) << "  poly list" << "列出已保存的多项式" << '\n'
+        << std::setw(COL_WIDTH) << "  poly show <name>" << "显示多项式" << '\n'
+        << std::setw(COL_WIDTH) << "  poly eval <name> <x>" << "计算 P(x)" << '\n'
+        << std::setw(COL_WIDTH) << "  poly deriv <name>" << "输出导数" << '\n'
+        << std::setw(COL_WIDTH) << "  poly roots <name>" << "求全部复根及误差界" << '\n'
+        << std::setw(COL_WIDTH) << "  poly compose <P> <Q>" << "显示 P(Q(x)) 的结果" << '\n'
+        << std::setw(COL_WIDTH) << "  poly shift <P> <a>" << "显示 P(x + a) 的结果" << '\n'
+        << std::setw(COL_WIDTH) << "  poly add <A> <B>" << "显示 A+B 的结果" << '\n'
+        << std::setw(COL_WIDTH) << "  poly sub <A> <B>" << "显示 A-B 的结果" << '\n'
+        << std::setw(COL_WIDTH) << "  poly mul <A> <B>" << "显示 A×B 的结果" << '\n'
+        << std::setw(COL_WIDTH) << "  poly calc R = <expr>" << "按表达式计算并保存，如 (p1 + p2) * p3' - p4" << '\n'
+        << std::setw(COL_WIDTH) << "  poly mnew <name> <poly>" << "创建多元多项式，如 3x^2y - 2yz + 1" << '\n'
+        << std::setw(COL_WIDTH) << "  poly mshow <name>" << "显示多元多项式" << '\n'
+        << std::setw(COL_WIDTH) << "  poly meval <name> x=1 .." << "计算多元多项式的值" << '\n'
+        << std::setw(COL_WIDTH) << "  poly mdiff <name> <var>" << "输出偏导数" << '\n'
+        << std::setw(COL_WIDTH) << "  poly madd|msub|mmul A B" << "多元多项式的和/差/积" << '\n'
+        << std::setw(COL_WIDTH) << "  poly snew <name> <terms>" << "创建紧凑稀疏多项式 (64 位指数)" << '\n'
+        << std::setw(COL_WIDTH) << "  poly pack <name>" << "把多项式转为紧凑存储" << '\n'
+        << std::setw(COL_WIDTH) << "  poly sshow|sdiff <name>" << "显示紧凑多项式/导数" << '\n'
+        << std::setw(COL_WIDTH) << "  poly seval <name> <x>" << "计算紧凑多项式的值" << '\n'
+        << std::setw(COL_WIDTH) << "  poly sadd|ssub|smul A B" << "紧凑多项式的和/差/积" << '\n'
+        << std::setw(COL_WIDTH) << "  poly dimport <name> <f>" << "从文本文件导入磁盘多项式 (项可无序，外部排序)" << '\n'
+        << std::setw(COL_WIDTH) << "  poly dexport <name> <f>" << "把磁盘多项式导出为文本" << '\n'
+        << std::setw(COL_WIDTH) << "  poly spill|fetch <name>" << "在内存与磁盘之间转存多项式" << '\n'
+        << std::setw(COL_WIDTH) << "  poly dshow <name> [k]" << "显示磁盘多项式的大小与前 k 项" << '\n'
+        << std::setw(COL_WIDTH) << "  poly deval <name> <x>" << "流式计算磁盘多项式的值" << '\n'
+        << std::setw(COL_WIDTH) << "  poly dadd|dsub|dmul R A B" << "磁盘上的和/差/积，结果存为 R" << '\n'
+        << std::setw(COL_WIDTH) << "  poly drop <name>" << "删除多项式 (全部存储形式)" << '\n'
+        << std::setw(COL_WIDTH) << "  mem" << "显示每个多项式的内存与分配器开销" << '\n'
+        << std::setw(COL_WIDTH) << "  compact" << "把多项式整理为连续存储并归还空闲内存" << '\n'
+        << std::setw(COL_WIDTH) << "  save <file>" << "保存全部多项式到二进制快照" << '\n'
+        << std::setw(COL_WIDTH) << "  load <file>" << "从快照载入多项式" << '\n'
+        << std::setw(COL_WIDTH) << "  set timeout <5s|off>" << "每条命令的时间上限" << '\n'
+        << std::setw(COL_WIDTH) << "  set memory <512M|off>" << "每条命令的内存预算" << '\n'
+        << std::setw(COL_WIDTH) << "  set progress on|off" << "长时间命令显示进度" << '\n'
+        << std::setw(COL_WIDTH) << "  set workmem <64M>" << "磁盘运算的工作内存上限" << '\n'
+        << std::setw(COL_WIDTH) << "  set tmpdir <dir>" << "磁盘多项式的文件目录" << '\n'
+        << std::setw(COL_WIDTH) << "  Ctrl-C" << "中断正在运行的命令" << '\n'
+        << std::setw(COL_WIDTH) << "  stats [reset]" << "显示/清零性能统计" << '\n'
+        << std::setw(COL_WIDTH) << "  trace on <file> | off" << "记录 Chrome trace 事件" << '\n'
+        << std::setw(COL_WIDTH) << "  exit" << "退出程序" << '\n';
+}
+
+std::string command_key(const std::string &line) {
+    // "poly add A B" is recorded as "poly add"
+    auto [command, payload] = split_command(line);
+    if (command != "poly") {
+        return command;
+    }
+    auto [sub, rest] = split_command(payload);
+    return sub.empty() ? command : command + " " + sub;
+}
+
+CommandStatus execute_command(CLIContext &ctx, const std::string &line, std::istream &in, std::ostream &out) {
+    auto [command, payload] = split_command(line);
+    if (command.empty()) {
+        return CommandStatus::Continue;
+    }
+    if (command == "exit" || command == "quit") {
+        out << "再见！\n";
+        return CommandStatus::Exit;
+    }
+    trace::Scope command_scope(trace::active() ? trace::intern(command_key(line)) : "");
+#if CALC_STATS_ENABLED
+    struct LatencyRecorder {
+        // records on every exit path, including errors
+        std::string key;
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        ~LatencyRecorder() {
+            if (!key.empty()) {
+                auto elapsed = std::chrono::steady_clock::now() - started;
+                stats::record_latency(key, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            }
+        }
+    } recorder{command_key(line)};
+#endif
+    try {
+        cancel::Scope cancel_scope(ctx.limits, ctx.interruptible, progress_sink(ctx));
+        if (command == "help") {
+            print_help(out);
+        } else if (command == "expr") {
+            handle_expr_command(out, payload);
+        } else if (command == "poly") {
+            handle_poly_command(ctx, payload, in, out);
+        } else if (command == "save") {
+            handle_save_command(ctx, payload, out);
+        } else if (command == "load") {
+            handle_load_command(ctx, payload, out);
+        } else if (command == "set") {
+            handle_set_command(ctx, payload, out);
+        } else if (command == "mem") {
+            handle_mem_command(ctx, out);
+        } else if (command == "compact") {
+            handle_compact_command(ctx, out);
+        } else if (command == "stats") {
+#if CALC_STATS_ENABLED
+            recorder.key.clear(); // do not count reading the statistics
+#endif
+            handle_stats_command(payload, out);
+        } else if (command == "trace") {
+            handle_trace_command(payload, out);
+        } else if (command == "banner") {
+            print_banner(out);
+        } else {
+#if CALC_STATS_ENABLED
+            recorder.key.clear();
+#endif
+            out << std::format("未知指令：{}，输入 help 查看帮助。\n", command);
+        }
+    } catch (const cancel::Cancelled &e) {
+        // the kernels report in English, the session in its own words
+        throw std::runtime_error(describe_cancel(ctx, e.reason()));
+    }
+    return CommandStatus::Continue;
+}
@@ -0,0 +1,90 @@
+#include "client.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+ServerConnection::ServerConnection(const std::string &) : fd_(-1) {
+    throw std::runtime_error("server mode is not supported on this platform");
+}
+
+ServerConnection::~ServerConnection() = default;
+
+ServerResponse ServerConnection::request(const std::string &) {
+    throw std::runtime_error("server mode is not supported on this platform");
+}
+
+void ServerConnection::fill() {}
+
+#else
+
+ServerConnection::ServerConnection(const std::string &socket_path) : fd_(-1) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("socket path is too long");
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+        throw std::runtime_error("cannot create socket");
+    }
+    if (::connect(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        ::close(fd_);
+        throw std::runtime_error("cannot connect to " + socket_path);
+    }
+}
+
+ServerConnection::~ServerConnection() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void ServerConnection::fill() {
+    char chunk[65536];
+    ssize_t received = ::recv(fd_, chunk, sizeof(chunk), 0);
+    if (received <= 0) {
+        throw std::runtime_error("connection closed by server");
+    }
+    buffer_.append(chunk, static_cast<std::size_t>(received));
+}
+
+ServerResponse ServerConnection::request(const std::string &line) {
+    std::string message = line + '\n';
+    std::size_t sent = 0;
+    while (sent < message.size()) {
+        ssize_t n = ::send(fd_, message.data() + sent, message.size() - sent, 0);
+        if (n <= 0) {
+            throw std::runtime_error("connection closed by server");
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+
+    std::size_t newline;
+    while ((newline = buffer_.find('\n')) == std::string::npos) {
+        fill();
+    }
+    std::string status = buffer_.substr(0, newline);
+    buffer_.erase(0, newline + 1);
+    auto space = status.find(' ');
+    if (space == std::string::npos) {
+        throw std::runtime_error("malformed response from server");
+    }
+    std::size_t length = std::stoull(status.substr(space + 1));
+    while (buffer_.size() < length) {
+        fill();
+    }
+    ServerResponse response{status.compare(0, space, "OK") == 0, buffer_.substr(0, length)};
+    buffer_.erase(0, length);
+    return response;
+}
+
+#endif
@@ -0,0 +1,404 @@
+#include "compact_poly.hpp"
+#include "cancel.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr double EPSILON = 1e-9;
+// runs per evaluation task
+constexpr std::size_t EVAL_GRAIN = 64;
+
+bool is_zero(double value) {
+	return std::abs(value) < EPSILON;
+}
+
+void put_varint(std::vector<std::uint8_t> &out, std::uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back(static_cast<std::uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t get_varint(const std::uint8_t *data, std::size_t &offset) {
+	std::uint64_t value = 0;
+	for (int shift = 0;; shift += 7) {
+		std::uint8_t byte = data[offset++];
+		value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+}
+
+// small magnitudes of either sign get short codes
+std::uint64_t zigzag(std::int64_t value) {
+	return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+	return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+std::int64_t add_exponents(std::int64_t a, std::int64_t b) {
+	if ((b > 0 && a > std::numeric_limits<std::int64_t>::max() - b)
+	    || (b < 0 && a < std::numeric_limits<std::int64_t>::min() - b)) {
+		throw std::runtime_error("指数超出 64 位整数范围");
+	}
+	return a + b;
+}
+
+double power(double base, std::uint64_t exp) {
+	double result = 1.0;
+	while (exp) {
+		if (exp & 1) result *= base;
+		base *= base;
+		exp >>= 1;
+	}
+	return result;
+}
+
+// x^e for any 64-bit e, also INT64_MIN
+double power(double base, std::int64_t exp) {
+	if (exp < 0) {
+		return power(1.0 / base, std::uint64_t{0} - static_cast<std::uint64_t>(exp));
+	}
+	return power(base, static_cast<std::uint64_t>(exp));
+}
+
+CompactPolynomial combine(const CompactPolynomial &a, const CompactPolynomial &b, double sign) {
+	CompactPolynomial::Builder builder;
+	CompactPolynomial::Cursor i = a.begin();
+	CompactPolynomial::Cursor j = b.begin();
+	std::size_t steps = 0;
+	while (!i.done() || !j.done()) {
+		if (++steps % 4096 == 0) {
+			cancel::checkpoint();
+		}
+		if (j.done() || (!i.done() && i.term().exponent > j.term().exponent)) {
+			builder.append(i.term().coefficient, i.term().exponent);
+			i.next();
+		} else if (i.done() || j.term().exponent > i.term().exponent) {
+			builder.append(sign * j.term().coefficient, j.term().exponent);
+			j.next();
+		} else {
+			builder.append(i.term().coefficient + sign * j.term().coefficient, i.term().exponent);
+			i.next();
+			j.next();
+		}
+	}
+	return builder.finish();
+}
+
+} // namespace
+
+void CompactPolynomial::Cursor::decode() {
+	const std::uint8_t *data = poly->exponents.data();
+	if (index % RUN_LENGTH == 0) {
+		exponent = unzigzag(get_varint(data, offset));
+	} else {
+		// deltas are taken modulo 2^64, a span wider than INT64_MAX still fits
+		exponent = static_cast<std::int64_t>(static_cast<std::uint64_t>(exponent) - get_varint(data, offset));
+	}
+}
+
+void CompactPolynomial::Cursor::next() {
+	if (++index < count) {
+		decode();
+	}
+}
+
+void CompactPolynomial::Builder::append(double coefficient, std::int64_t exponent) {
+	if (!coefficients.empty() && exponent >= last) {
+		throw std::runtime_error("项必须按指数降序追加");
+	}
+	if (is_zero(coefficient)) {
+		return;
+	}
+	if (coefficients.size() % RUN_LENGTH == 0) {
+		runs.push_back(exponents.size());
+		put_varint(exponents, zigzag(exponent));
+	} else {
+		put_varint(exponents, static_cast<std::uint64_t>(last) - static_cast<std::uint64_t>(exponent));
+	}
+	coefficients.push_back(coefficient);
+	last = exponent;
+}
+
+CompactPolynomial CompactPolynomial::Builder::finish() {
+	CompactPolynomial result;
+	coefficients.shrink_to_fit();
+	exponents.shrink_to_fit();
+	runs.shrink_to_fit();
+	result.coefficients = std::move(coefficients);
+	result.exponents = std::move(exponents);
+	result.runs = std::move(runs);
+	coefficients.clear();
+	exponents.clear();
+	runs.clear();
+	return result;
+}
+
+CompactPolynomial::CompactPolynomial(const Polynomial &poly) {
+	Builder builder;
+	for (const PolyTerm *node = poly.terms(); node; node = node->next) {
+		builder.append(node->coefficient, node->exponent);
+	}
+	*this = builder.finish();
+}
+
+Polynomial CompactPolynomial::toPolynomial() const {
+	std::vector<int> list_exponents;
+	list_exponents.reserve(coefficients.size());
+	for (Cursor cursor = begin(); !cursor.done(); cursor.next()) {
+		std::int64_t exponent = cursor.term().exponent;
+		if (exponent < INT_MIN || exponent > INT_MAX) {
+			throw std::runtime_error("指数超出普通多项式的 int 范围");
+		}
+		list_exponents.push_back(static_cast<int>(exponent));
+	}
+	return Polynomial::fromSortedTerms(coefficients.data(), list_exponents.data(), coefficients.size());
+}
+
+CompactPolynomial CompactPolynomial::read(std::istream &is) {
+	std::vector<Term> terms;
+	long long n = 0;
+	is >> n;
+	// stop at the first bad read so a short or empty stream cannot spin
+	while (n-- > 0) {
+		Term term;
+		if (!(is >> term.coefficient >> term.exponent)) {
+			break;
+		}
+		terms.push_back(term);
+	}
+	std::sort(terms.begin(), terms.end(), [](const Term &x, const Term &y) { return x.exponent > y.exponent; });
+	Builder builder;
+	for (std::size_t i = 0; i < terms.size();) {
+		double coefficient = 0.0;
+		std::int64_t exponent = terms[i].exponent;
+		for (; i < terms.size() && terms[i].exponent == exponent; ++i) {
+			coefficient += terms[i].coefficient;
+		}
+		builder.append(coefficient, exponent);
+	}
+	return builder.finish();
+}
+
+CompactPolynomial operator+(const CompactPolynomial &a, const CompactPolynomial &b) {
+	CALC_TRACE_SCOPE("compact_add");
+	return combine(a, b, 1.0);
+}
+
+CompactPolynomial CompactPolynomial::operator-() const {
+	// the exponent stream does not change
+	CompactPolynomial result = *this;
+	for (double &coefficient : result.coefficients) {
+		coefficient = -coefficient;
+	}
+	return result;
+}
+
+CompactPolynomial operator-(const CompactPolynomial &a, const CompactPolynomial &b) {
+	CALC_TRACE_SCOPE("compact_sub");
+	return combine(a, b, -1.0);
+}
+
+CompactPolynomial operator*(const CompactPolynomial &a, const CompactPolynomial &b) {
+	CALC_TRACE_SCOPE("compact_mul");
+	const CompactPolynomial *lhs = &a;
+	const CompactPolynomial *rhs = &b;
+	if (lhs->termCount() > rhs->termCount()) {
+		std::swap(lhs, rhs);
+	}
+	if (lhs->termCount() == 0) {
+		return {};
+	}
+	// every term of the shorter factor times the longer one is a run in
+	// descending order; a max-heap over the heads of those runs yields the
+	// products in order (Johnson's method), streaming both factors. The heap
+	// keeps the product exponent next to its row so sifting does not chase
+	// into the rows, and the next product of a row replaces the top in
+	// place: one sift-down instead of a pop and a push
+	struct Row {
+		CompactPolynomial::Cursor cursor; // into rhs
+		double coefficient;
+		std::int64_t exponent;
+	};
+	struct Head {
+		std::int64_t product;
+		std::size_t row;
+	};
+	std::vector<Row> rows;
+	std::vector<Head> heap;
+	rows.reserve(lhs->termCount());
+	heap.reserve(lhs->termCount());
+	for (auto cursor = lhs->begin(); !cursor.done(); cursor.next()) {
+		auto [coefficient, exponent] = cursor.term();
+		CompactPolynomial::Cursor head = rhs->begin();
+		// rows start in descending order, appending keeps a valid heap
+		heap.push_back({add_exponents(exponent, head.term().exponent), rows.size()});
+		rows.push_back({head, coefficient, exponent});
+	}
+	auto sift_down = [&heap]() {
+		const std::size_t size = heap.size();
+		std::size_t slot = 0;
+		Head moving = heap[0];
+		while (true) {
+			std::size_t child = 2 * slot + 1;
+			if (child >= size) {
+				break;
+			}
+			if (child + 1 < size && heap[child + 1].product > heap[child].product) {
+				++child;
+			}
+			if (heap[child].product <= moving.product) {
+				break;
+			}
+			heap[slot] = heap[child];
+			slot = child;
+		}
+		heap[slot] = moving;
+	};
+
+	const std::size_t products = lhs->termCount() * rhs->termCount();
+	std::size_t done = 0;
+	CompactPolynomial::Builder builder;
+	double pending = 0.0;
+	std::int64_t pending_exponent = heap.front().product;
+	while (!heap.empty()) {
+		if (++done % 4096 == 0) {
+			cancel::progress("poly smul", done, products);
+		}
+		Head &top = heap.front();
+		Row &row = rows[top.row];
+		if (top.product != pending_exponent) {
+			builder.append(pending, pending_exponent);
+			pending = 0.0;
+			pending_exponent = top.product;
+		}
+		pending += row.coefficient * row.cursor.term().coefficient;
+		row.cursor.next();
+		if (row.cursor.done()) {
+			top = heap.back();
+			heap.pop_back();
+		} else {
+			top.product = add_exponents(row.exponent, row.cursor.term().exponent);
+		}
+		if (!heap.empty()) {
+			sift_down();
+		}
+	}
+	builder.append(pending, pending_exponent);
+	return builder.finish();
+}
+
+double CompactPolynomial::evaluate(double x) const {
+	CALC_TRACE_SCOPE("compact_evaluate");
+	// Horner over the gaps inside a run, the runs summed in order; runs are
+	// independent, large polynomials spread them over the pool
+	auto evaluate_runs = [&](std::size_t first, std::size_t last) {
+		double sum = 0.0;
+		for (std::size_t r = first; r < last; ++r) {
+			Cursor cursor = run(r);
+			double value = cursor.term().coefficient;
+			std::int64_t previous = cursor.term().exponent;
+			std::size_t end = std::min(coefficients.size(), (r + 1) * RUN_LENGTH);
+			for (cursor.next(); cursor.index < end; cursor.next()) {
+				auto [coefficient, exponent] = cursor.term();
+				value = value * power(x, static_cast<std::uint64_t>(previous) - static_cast<std::uint64_t>(exponent)) + coefficient;
+				previous = exponent;
+			}
+			sum += value * power(x, previous);
+		}
+		return sum;
+	};
+	const std::size_t count = runCount();
+	if (count <= EVAL_GRAIN) {
+		return evaluate_runs(0, count);
+	}
+	std::vector<double> partial((count + EVAL_GRAIN - 1) / EVAL_GRAIN);
+	TaskGroup group(ThreadPool::global());
+	for (std::size_t block = 0; block < partial.size(); ++block) {
+		group.run([&, block] {
+			cancel::checkpoint();
+			partial[block] = evaluate_runs(block * EVAL_GRAIN, std::min(count, (block + 1) * EVAL_GRAIN));
+		});
+	}
+	group.wait();
+	double sum = 0.0;
+	for (double value : partial) {
+		sum += value;
+	}
+	return sum;
+}
+
+CompactPolynomial CompactPolynomial::derivative() const {
+	CALC_TRACE_SCOPE("compact_derivative");
+	Builder builder;
+	for (Cursor cursor = begin(); !cursor.done(); cursor.next()) {
+		auto [coefficient, exponent] = cursor.term();
+		if (exponent == 0) {
+			continue;
+		}
+		builder.append(coefficient * static_cast<double>(exponent), add_exponents(exponent, -1));
+	}
+	return builder.finish();
+}
+
+CompactPolynomial::Cursor CompactPolynomial::begin() const {
+	return run(0);
+}
+
+CompactPolynomial::Cursor CompactPolynomial::run(std::size_t index) const {
+	Cursor cursor;
+	cursor.poly = this;
+	cursor.count = coefficients.size();
+	cursor.index = std::min(index * RUN_LENGTH, cursor.count);
+	if (cursor.index < cursor.count) {
+		cursor.offset = runs[index];
+		cursor.decode();
+	}
+	return cursor;
+}
+
+std::size_t CompactPolynomial::runCount() const {
+	return runs.size();
+}
+
+std::size_t CompactPolynomial::termCount() const {
+	return coefficients.size();
+}
+
+std::size_t CompactPolynomial::memoryBytes() const {
+	return coefficients.capacity() * sizeof(double) + exponents.capacity() + runs.capacity() * sizeof(std::size_t);
+}
+
+MemoryUsage CompactPolynomial::memoryUsage() const {
+	MemoryUsage usage{memoryBytes(), 0};
+	auto add = [&usage](const void *data, std::size_t bytes) {
+		if (bytes > 0) {
+			usage.overhead += allocation_overhead(data, bytes);
+		}
+	};
+	add(coefficients.data(), coefficients.capacity() * sizeof(double));
+	add(exponents.data(), exponents.capacity());
+	add(runs.data(), runs.capacity() * sizeof(std::size_t));
+	return usage;
+}
+
+void CompactPolynomial::print(std::ostream &os) const {
+	os << coefficients.size();
+	for (Cursor cursor = begin(); !cursor.done(); cursor.next()) {
+		os << ' ' << cursor.term().coefficient << ' ' << cursor.term().exponent;
+	}
+	os << std::endl;
+}
@@ -0,0 +1,221 @@
+#include "polynomial.hpp"
+#include "cancel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <numbers>
+#include <stdexcept>
+
+namespace {
+
+using Complex = std::complex<double>;
+using Dense = std::vector<double>; // coefficient of x^k at index k
+
+// products whose shorter factor has at most this many coefficients are
+// computed directly; the FFT only pays off above it
+constexpr std::size_t SCHOOLBOOK_LIMIT = 48;
+// blocks of the outer polynomial up to this length are evaluated by Horner
+constexpr std::size_t HORNER_LIMIT = 32;
+// the result is held as a dense array of this many coefficients at most
+constexpr std::size_t MAX_DEGREE = std::size_t{1} << 24;
+
+// operation names the caller in error messages
+Dense to_dense(const Polynomial &p, const char *operation) {
+	const PolyTerm *node = p.terms();
+	if (!node) {
+		return {};
+	}
+	if (node->exponent >= 0 && static_cast<std::size_t>(node->exponent) > MAX_DEGREE) {
+		throw std::runtime_error(std::format("次数超过{}的上限 {}", operation, MAX_DEGREE));
+	}
+	Dense dense(node->exponent < 0 ? 0 : static_cast<std::size_t>(node->exponent) + 1, 0.0);
+	for (; node; node = node->next) {
+		if (node->exponent < 0) {
+			throw std::runtime_error(std::format("{}要求指数非负", operation));
+		}
+		dense[static_cast<std::size_t>(node->exponent)] = node->coefficient;
+	}
+	return dense;
+}
+
+Polynomial from_dense(const Dense &dense) {
+	std::vector<double> coefficients;
+	std::vector<int> exponents;
+	for (std::size_t k = dense.size(); k-- > 0;) {
+		if (dense[k] != 0.0) {
+			coefficients.push_back(dense[k]);
+			exponents.push_back(static_cast<int>(k));
+		}
+	}
+	return Polynomial::fromSortedTerms(coefficients.data(), exponents.data(), coefficients.size());
+}
+
+// in-place iterative radix-2 transform; data.size() is a power of two
+void fft(std::vector<Complex> &data, bool inverse) {
+	const std::size_t n = data.size();
+	for (std::size_t i = 1, j = 0; i < n; ++i) {
+		std::size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1) {
+			j ^= bit;
+		}
+		j ^= bit;
+		if (i < j) {
+			std::swap(data[i], data[j]);
+		}
+	}
+	// every twiddle comes straight from cos/sin, a running product would
+	// drift by O(n) ulps
+	std::vector<Complex> roots(n / 2);
+	const double sign = inverse ? 1.0 : -1.0;
+	for (std::size_t k = 0; k < n / 2; ++k) {
+		double angle = sign * 2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(n);
+		roots[k] = {std::cos(angle), std::sin(angle)};
+	}
+	for (std::size_t length = 2; length <= n; length <<= 1) {
+		const std::size_t half = length / 2;
+		const std::size_t step = n / length;
+		for (std::size_t start = 0; start < n; start += length) {
+			for (std::size_t k = 0; k < half; ++k) {
+				Complex u = data[start + k];
+				Complex v = data[start + k + half] * roots[k * step];
+				data[start + k] = u + v;
+				data[start + k + half] = u - v;
+			}
+		}
+	}
+}
+
+// errors of the FFT path are relative to the largest coefficients of the
+// factors (normwise), like for any floating-point fast multiplication
+Dense multiply(const Dense &a, const Dense &b) {
+	if (a.empty() || b.empty()) {
+		return {};
+	}
+	cancel::checkpoint();
+	const std::size_t size = a.size() + b.size() - 1;
+	Dense result(size, 0.0);
+	if (std::min(a.size(), b.size()) <= SCHOOLBOOK_LIMIT) {
+		const Dense &shorter = a.size() <= b.size() ? a : b;
+		const Dense &longer = a.size() <= b.size() ? b : a;
+		for (std::size_t i = 0; i < shorter.size(); ++i) {
+			for (std::size_t j = 0; j < longer.size(); ++j) {
+				result[i + j] += shorter[i] * longer[j];
+			}
+		}
+		return result;
+	}
+	CALC_TRACE_SCOPE("fft_multiply");
+	// one transform carries both factors as z = a + i*s*b; the imaginary
+	// part of z^2 is 2*s*(a*b). s balances the norms so neither factor is
+	// lost in the rounding of the other
+	double norm_a = 0.0, norm_b = 0.0;
+	for (double c : a) {
+		norm_a = std::max(norm_a, std::abs(c));
+	}
+	for (double c : b) {
+		norm_b = std::max(norm_b, std::abs(c));
+	}
+	if (norm_a == 0.0 || norm_b == 0.0) {
+		return result;
+	}
+	const double scale = norm_a / norm_b;
+	std::vector<Complex> z(std::bit_ceil(size), Complex{});
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		z[i].real(a[i]);
+	}
+	for (std::size_t i = 0; i < b.size(); ++i) {
+		z[i].imag(b[i] * scale);
+	}
+	fft(z, false);
+	for (auto &value : z) {
+		value *= value;
+	}
+	cancel::checkpoint();
+	fft(z, true);
+	const double factor = 1.0 / (2.0 * scale * static_cast<double>(z.size()));
+	for (std::size_t i = 0; i < size; ++i) {
+		result[i] = z[i].imag() * factor;
+	}
+	return result;
+}
+
+void add_into(Dense &target, const Dense &source) {
+	if (target.size() < source.size()) {
+		target.resize(source.size(), 0.0);
+	}
+	for (std::size_t i = 0; i < source.size(); ++i) {
+		target[i] += source[i];
+	}
+}
+
+// p[begin, end) as a polynomial in q, that is sum p[begin + k] * q^k.
+// powers[k] = q^(2^k). A block splits at m = 2^k into low + q^m * high,
+// so the work is O(M(n) log n) for the fast multiplication cost M
+Dense compose_range(const Dense &p, std::size_t begin, std::size_t end, const std::vector<Dense> &powers) {
+	const Dense &q = powers[0];
+	if (end - begin <= HORNER_LIMIT) {
+		Dense result{p[end - 1]};
+		for (std::size_t i = end - 1; i-- > begin;) {
+			if (q.size() == 2) {
+				// linear inner polynomial: one pass instead of a product
+				result.push_back(0.0);
+				for (std::size_t j = result.size() - 1; j > 0; --j) {
+					result[j] = result[j] * q[0] + result[j - 1] * q[1];
+				}
+				result[0] *= q[0];
+			} else {
+				result = multiply(result, q);
+			}
+			result[0] += p[i];
+		}
+		return result;
+	}
+	const std::size_t level = static_cast<std::size_t>(std::bit_width(end - begin - 1)) - 1;
+	const std::size_t middle = begin + (std::size_t{1} << level);
+	Dense result = compose_range(p, begin, middle, powers);
+	add_into(result, multiply(compose_range(p, middle, end, powers), powers[level]));
+	return result;
+}
+
+Dense compose_dense(const Dense &p, const Dense &q) {
+	std::vector<Dense> powers{q};
+	while ((std::size_t{2} << (powers.size() - 1)) < p.size()) {
+		powers.push_back(multiply(powers.back(), powers.back()));
+	}
+	return compose_range(p, 0, p.size(), powers);
+}
+
+void check_degree(std::size_t outer, std::size_t inner) {
+	if (inner != 0 && outer > MAX_DEGREE / inner) {
+		throw std::runtime_error(std::format("结果的次数超过上限 {}", MAX_DEGREE));
+	}
+}
+
+} // namespace
+
+Polynomial Polynomial::compose(const Polynomial &inner) const {
+	CALC_TRACE_SCOPE("compose");
+	Dense p = to_dense(*this, "复合");
+	Dense q = to_dense(inner, "复合");
+	if (p.size() <= 1 || q.size() <= 1) {
+		// a constant on either side: the result is a constant
+		Polynomial result;
+		result.addTerm(p.empty() ? 0.0 : evaluate(q.empty() ? 0.0 : q[0]), 0);
+		return result;
+	}
+	check_degree(p.size() - 1, q.size() - 1);
+	return from_dense(compose_dense(p, q));
+}
+
+Polynomial Polynomial::shift(double a) const {
+	CALC_TRACE_SCOPE("shift");
+	Dense p = to_dense(*this, "平移");
+	if (p.size() <= 1 || a == 0.0) {
+		return *this;
+	}
+	check_degree(p.size() - 1, 1);
+	return from_dense(compose_dense(p, Dense{a, 1.0}));
+}
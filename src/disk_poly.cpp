@@ -0,0 +1,529 @@
+#include "disk_poly.hpp"
+#include "cancel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <limits>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+struct DiskPolynomial::File {
+	explicit File(std::string name) : path(std::move(name)) {}
+	File(const File &) = delete;
+	File &operator=(const File &) = delete;
+	~File() {
+		std::remove(path.c_str());
+	}
+
+	std::string path;
+};
+
+namespace {
+
+using Term = DiskPolynomial::Term;
+
+constexpr double EPSILON = 1e-9;
+// smallest buffer worth a read or write call; merges cap their fan-in so
+// every input keeps at least this much
+constexpr std::size_t MIN_BUFFER = std::size_t{64} << 10;
+// descriptors left to the rest of the process (standard streams, server
+// sockets, a snapshot) when a merge sizes its fan-in to the open-file limit
+constexpr std::size_t RESERVED_FILES = 16;
+
+static_assert(sizeof(Term) == 16, "term files store packed 16-byte records");
+
+bool is_zero(double value) {
+	return std::abs(value) < EPSILON;
+}
+
+std::int64_t add_exponents(std::int64_t a, std::int64_t b) {
+	if ((b > 0 && a > std::numeric_limits<std::int64_t>::max() - b)
+	    || (b < 0 && a < std::numeric_limits<std::int64_t>::min() - b)) {
+		throw std::runtime_error("指数超出 64 位整数范围");
+	}
+	return a + b;
+}
+
+double power(double base, std::uint64_t exp) {
+	double result = 1.0;
+	while (exp) {
+		if (exp & 1) result *= base;
+		base *= base;
+		exp >>= 1;
+	}
+	return result;
+}
+
+double power(double base, std::int64_t exp) {
+	if (exp < 0) {
+		return power(1.0 / base, std::uint64_t{0} - static_cast<std::uint64_t>(exp));
+	}
+	return power(base, static_cast<std::uint64_t>(exp));
+}
+
+// a share of the working memory for one buffer
+std::size_t share(const DiskLimits &limits, std::size_t parts) {
+	return std::max(MIN_BUFFER, limits.memory_bytes / parts);
+}
+
+std::string temporary_path(const DiskLimits &limits) {
+	// the tag keeps concurrent calculators in one directory apart
+	static const std::uint32_t tag = std::random_device{}();
+	static std::atomic<std::uint64_t> counter{0};
+	std::filesystem::path directory = limits.directory.empty() ? std::filesystem::temp_directory_path()
+	                                                           : std::filesystem::path(limits.directory);
+	std::string name = "calc-" + std::to_string(tag) + "-" + std::to_string(counter.fetch_add(1)) + ".terms";
+	return (directory / name).string();
+}
+
+// memory held by a buffer, charged to the running command for its lifetime
+class Charge {
+public:
+	explicit Charge(std::size_t bytes) : bytes_(static_cast<std::ptrdiff_t>(bytes)) {
+		cancel::charge(bytes_);
+		cancel::checkpoint();
+	}
+	~Charge() {
+		cancel::charge(-bytes_);
+	}
+	Charge(const Charge &) = delete;
+	Charge &operator=(const Charge &) = delete;
+
+private:
+	std::ptrdiff_t bytes_;
+};
+
+// k-way merge of sorted files into one, summing equal exponents
+DiskPolynomial merge_group(const std::vector<DiskPolynomial> &inputs, const std::vector<double> &scales,
+                           const DiskLimits &limits, bool keep_zeros, const char *task) {
+	const std::size_t buffer = share(limits, inputs.size() + 1);
+	std::vector<std::unique_ptr<DiskPolynomial::Reader>> readers;
+	std::uint64_t total = 0;
+	// max-heap of the current head of every input, keyed by exponent
+	using Head = std::pair<std::int64_t, std::size_t>;
+	std::priority_queue<Head> heads;
+	for (std::size_t i = 0; i < inputs.size(); ++i) {
+		readers.push_back(std::make_unique<DiskPolynomial::Reader>(inputs[i], buffer));
+		total += inputs[i].termCount();
+		if (!readers[i]->done()) {
+			heads.push({readers[i]->term().exponent, i});
+		}
+	}
+	DiskPolynomial::Writer writer(limits, buffer, keep_zeros);
+	std::uint64_t done = 0;
+	while (!heads.empty()) {
+		std::int64_t exponent = heads.top().first;
+		double coefficient = 0.0;
+		while (!heads.empty() && heads.top().first == exponent) {
+			std::size_t i = heads.top().second;
+			heads.pop();
+			coefficient += scales[i] * readers[i]->term().coefficient;
+			readers[i]->next();
+			if (!readers[i]->done()) {
+				heads.push({readers[i]->term().exponent, i});
+			}
+			if (++done % 4096 == 0) {
+				cancel::progress(task, done, total);
+			}
+		}
+		writer.append(coefficient, exponent);
+	}
+	return writer.finish();
+}
+
+// files the process may hold open at once
+std::size_t open_file_limit() {
+#ifdef _WIN32
+	return static_cast<std::size_t>(_getmaxstdio());
+#else
+	rlimit limit{};
+	if (::getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+		return std::numeric_limits<std::size_t>::max();
+	}
+	return static_cast<std::size_t>(limit.rlim_cur);
+#endif
+}
+
+// inputs beyond the fan-in are merged in groups first, one pass per level.
+// The fan-in is bounded by the memory for buffers and by the descriptors
+// left for the inputs and the output, so a low limit means more levels
+// rather than a failure to open a run
+DiskPolynomial merge(std::vector<DiskPolynomial> inputs, std::vector<double> scales, const DiskLimits &limits,
+                     const char *task) {
+	CALC_TRACE_SCOPE("disk_merge");
+	const std::size_t files = open_file_limit();
+	const std::size_t spare = files > RESERVED_FILES + 1 ? files - RESERVED_FILES - 1 : 0;
+	const std::size_t fan_in = std::max<std::size_t>(2, std::min(limits.memory_bytes / MIN_BUFFER - 1, spare));
+	while (inputs.size() > fan_in) {
+		std::vector<DiskPolynomial> merged;
+		for (std::size_t first = 0; first < inputs.size(); first += fan_in) {
+			std::size_t last = std::min(inputs.size(), first + fan_in);
+			std::vector<DiskPolynomial> group(inputs.begin() + first, inputs.begin() + last);
+			std::vector<double> group_scales(scales.begin() + first, scales.begin() + last);
+			merged.push_back(merge_group(group, group_scales, limits, true, task));
+		}
+		// the merged runs are dropped here, and their files with them
+		inputs = std::move(merged);
+		scales.assign(inputs.size(), 1.0);
+	}
+	return merge_group(inputs, scales, limits, false, task);
+}
+
+struct Row {
+	double coefficient;
+	std::int64_t exponent;
+	std::size_t next; // index of the next term in the block of the other factor
+};
+
+struct Head {
+	std::int64_t product;
+	std::size_t row;
+};
+
+// rows times block as one sorted run, by Johnson's heap method as in
+// CompactPolynomial's product: every row is a descending sequence and the
+// heap holds the next product of each; the next product of the top row
+// replaces it in place
+DiskPolynomial multiply_block(std::vector<Row> &rows, const std::vector<Term> &block, std::vector<Head> &heap,
+                              const DiskLimits &limits, std::size_t buffer, bool keep_zeros) {
+	heap.clear();
+	for (std::size_t r = 0; r < rows.size(); ++r) {
+		rows[r].next = 0;
+		// rows start in descending order, appending keeps a valid heap
+		heap.push_back({add_exponents(rows[r].exponent, block[0].exponent), r});
+	}
+	auto sift_down = [&heap]() {
+		const std::size_t size = heap.size();
+		std::size_t slot = 0;
+		Head moving = heap[0];
+		while (true) {
+			std::size_t child = 2 * slot + 1;
+			if (child >= size) {
+				break;
+			}
+			if (child + 1 < size && heap[child + 1].product > heap[child].product) {
+				++child;
+			}
+			if (heap[child].product <= moving.product) {
+				break;
+			}
+			heap[slot] = heap[child];
+			slot = child;
+		}
+		heap[slot] = moving;
+	};
+
+	DiskPolynomial::Writer writer(limits, buffer, keep_zeros);
+	double pending = 0.0;
+	std::int64_t pending_exponent = heap.front().product;
+	std::size_t steps = 0;
+	while (!heap.empty()) {
+		if (++steps % 4096 == 0) {
+			cancel::checkpoint();
+		}
+		Head &top = heap.front();
+		Row &row = rows[top.row];
+		if (top.product != pending_exponent) {
+			writer.append(pending, pending_exponent);
+			pending = 0.0;
+			pending_exponent = top.product;
+		}
+		pending += row.coefficient * block[row.next].coefficient;
+		if (++row.next == block.size()) {
+			top = heap.back();
+			heap.pop_back();
+		} else {
+			top.product = add_exponents(row.exponent, block[row.next].exponent);
+		}
+		if (!heap.empty()) {
+			sift_down();
+		}
+	}
+	writer.append(pending, pending_exponent);
+	return writer.finish();
+}
+
+} // namespace
+
+DiskPolynomial::Reader::Reader(const DiskPolynomial &poly, std::size_t buffer_bytes)
+    : file(poly.file), remaining(poly.count) {
+	std::uint64_t capacity = std::max<std::size_t>(1, buffer_bytes / sizeof(Term));
+	buffer.resize(static_cast<std::size_t>(std::max<std::uint64_t>(1, std::min(capacity, remaining))));
+	cancel::charge(static_cast<std::ptrdiff_t>(buffer.size() * sizeof(Term)));
+	if (remaining > 0) {
+		in.open(file->path, std::ios::binary);
+		if (!in) {
+			throw std::runtime_error(std::format("无法打开项文件 {}", file->path));
+		}
+	}
+	refill();
+}
+
+DiskPolynomial::Reader::~Reader() {
+	cancel::charge(-static_cast<std::ptrdiff_t>(buffer.size() * sizeof(Term)));
+}
+
+void DiskPolynomial::Reader::refill() {
+	position = 0;
+	filled = static_cast<std::size_t>(std::min<std::uint64_t>(buffer.size(), remaining));
+	if (filled == 0) {
+		return;
+	}
+	in.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(filled * sizeof(Term)));
+	if (!in) {
+		throw std::runtime_error(std::format("项文件 {} 不完整", file->path));
+	}
+	remaining -= filled;
+}
+
+DiskPolynomial::Writer::Writer(const DiskLimits &limits, std::size_t buffer_bytes, bool keep_zeros)
+    : file(std::make_shared<const File>(temporary_path(limits))), keep_zeros(keep_zeros) {
+	out.open(file->path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		throw std::runtime_error(std::format("无法创建项文件 {}", file->path));
+	}
+	buffer.reserve(std::max<std::size_t>(1, buffer_bytes / sizeof(Term)));
+	cancel::charge(static_cast<std::ptrdiff_t>(buffer.capacity() * sizeof(Term)));
+}
+
+DiskPolynomial::Writer::~Writer() {
+	cancel::charge(-static_cast<std::ptrdiff_t>(buffer.capacity() * sizeof(Term)));
+}
+
+void DiskPolynomial::Writer::append(double coefficient, std::int64_t exponent) {
+	if (written + buffer.size() > 0 && exponent >= last) {
+		throw std::runtime_error("项必须按指数降序追加");
+	}
+	if (!keep_zeros && is_zero(coefficient)) {
+		return;
+	}
+	if (buffer.size() == buffer.capacity()) {
+		flush();
+	}
+	buffer.push_back({coefficient, exponent});
+	last = exponent;
+}
+
+void DiskPolynomial::Writer::flush() {
+	out.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(Term)));
+	if (!out) {
+		throw std::runtime_error(std::format("写入项文件 {} 失败", file->path));
+	}
+	written += buffer.size();
+	buffer.clear();
+	cancel::checkpoint();
+}
+
+DiskPolynomial DiskPolynomial::Writer::finish() {
+	flush();
+	out.close();
+	if (!out) {
+		throw std::runtime_error(std::format("写入项文件 {} 失败", file->path));
+	}
+	DiskPolynomial result;
+	result.file = file;
+	result.count = written;
+	return result;
+}
+
+DiskPolynomial DiskPolynomial::fromSortedTerms(const Term *terms, std::size_t count, const DiskLimits &limits) {
+	Writer writer(limits, share(limits, 8));
+	for (std::size_t i = 0; i < count; ++i) {
+		writer.append(terms[i].coefficient, terms[i].exponent);
+	}
+	return writer.finish();
+}
+
+DiskPolynomial DiskPolynomial::fromCompact(const CompactPolynomial &poly, const DiskLimits &limits) {
+	Writer writer(limits, share(limits, 8));
+	for (auto cursor = poly.begin(); !cursor.done(); cursor.next()) {
+		writer.append(cursor.term().coefficient, cursor.term().exponent);
+	}
+	return writer.finish();
+}
+
+CompactPolynomial DiskPolynomial::toCompact(const DiskLimits &limits) const {
+	// a compact term takes at most 8 + 10 bytes, the decoded one 16
+	if (count > limits.memory_bytes / 18) {
+		throw std::runtime_error(std::format("多项式有 {} 项，超出工作内存 {} 字节", count, limits.memory_bytes));
+	}
+	CompactPolynomial::Builder builder;
+	for (Reader reader(*this, MIN_BUFFER); !reader.done(); reader.next()) {
+		builder.append(reader.term().coefficient, reader.term().exponent);
+	}
+	return builder.finish();
+}
+
+DiskPolynomial DiskPolynomial::read(std::istream &is, const DiskLimits &limits) {
+	CALC_TRACE_SCOPE("disk_read");
+	// sorted chunks of the input become runs; they are only summed and
+	// cleaned of zeros in the final merge
+	const std::size_t run_buffer = share(limits, 8);
+	const std::size_t chunk_terms = std::max<std::size_t>(1, (limits.memory_bytes - std::min(limits.memory_bytes, run_buffer)) / sizeof(Term));
+	std::vector<DiskPolynomial> runs;
+	{
+		Charge charge(chunk_terms * sizeof(Term));
+		std::vector<Term> chunk;
+		auto spill = [&](bool final) {
+			std::sort(chunk.begin(), chunk.end(), [](const Term &x, const Term &y) { return x.exponent > y.exponent; });
+			Writer writer(limits, run_buffer, !final);
+			for (std::size_t i = 0; i < chunk.size();) {
+				double coefficient = 0.0;
+				std::int64_t exponent = chunk[i].exponent;
+				for (; i < chunk.size() && chunk[i].exponent == exponent; ++i) {
+					coefficient += chunk[i].coefficient;
+				}
+				writer.append(coefficient, exponent);
+			}
+			runs.push_back(writer.finish());
+			chunk.clear();
+		};
+		long long n = 0;
+		is >> n;
+		// stop at the first bad read so a short or empty stream cannot spin
+		while (n-- > 0) {
+			Term term;
+			if (!(is >> term.coefficient >> term.exponent)) {
+				break;
+			}
+			if (chunk.empty()) {
+				chunk.reserve(chunk_terms);
+			}
+			chunk.push_back(term);
+			if (chunk.size() == chunk_terms) {
+				spill(false);
+			}
+		}
+		if (!chunk.empty() || runs.empty()) {
+			// input that fits one chunk is written final right away
+			spill(runs.empty());
+			if (runs.size() == 1) {
+				return std::move(runs.front());
+			}
+		}
+	}
+	std::vector<double> scales(runs.size(), 1.0);
+	return merge(std::move(runs), std::move(scales), limits, "poly dimport");
+}
+
+void DiskPolynomial::print(std::ostream &os) const {
+	os << count;
+	for (Reader reader(*this, MIN_BUFFER); !reader.done(); reader.next()) {
+		os << ' ' << reader.term().coefficient << ' ' << reader.term().exponent;
+	}
+	os << std::endl;
+}
+
+DiskPolynomial DiskPolynomial::add(const DiskPolynomial &a, const DiskPolynomial &b, const DiskLimits &limits) {
+	CALC_TRACE_SCOPE("disk_add");
+	return merge({a, b}, {1.0, 1.0}, limits, "poly dadd");
+}
+
+DiskPolynomial DiskPolynomial::subtract(const DiskPolynomial &a, const DiskPolynomial &b, const DiskLimits &limits) {
+	CALC_TRACE_SCOPE("disk_sub");
+	return merge({a, b}, {1.0, -1.0}, limits, "poly dsub");
+}
+
+DiskPolynomial DiskPolynomial::multiply(const DiskPolynomial &a, const DiskPolynomial &b, const DiskLimits &limits) {
+	CALC_TRACE_SCOPE("disk_mul");
+	const DiskPolynomial *lhs = &a;
+	const DiskPolynomial *rhs = &b;
+	if (lhs->count > rhs->count) {
+		std::swap(lhs, rhs);
+	}
+	if (lhs->count == 0) {
+		return {};
+	}
+	// half of the memory holds a block of the shorter factor with its heap,
+	// a quarter a block of the longer one, an eighth buffers the run
+	const std::size_t run_buffer = share(limits, 8);
+	const auto lhs_block = static_cast<std::size_t>(
+	    std::clamp<std::uint64_t>(limits.memory_bytes / 2 / (sizeof(Row) + sizeof(Head)), 1, lhs->count));
+	const auto rhs_block = static_cast<std::size_t>(
+	    std::clamp<std::uint64_t>(limits.memory_bytes / 4 / sizeof(Term), 1, rhs->count));
+	// a longer factor that fits its block is read once; then a shorter
+	// factor that fits too makes the whole product a single final run
+	const bool rhs_resident = rhs_block == rhs->count;
+	const bool single_run = rhs_resident && lhs_block == lhs->count;
+
+	Charge charge(lhs_block * (sizeof(Row) + sizeof(Head)) + rhs_block * sizeof(Term));
+	std::vector<Row> rows;
+	std::vector<Head> heap;
+	std::vector<Term> block;
+	rows.reserve(lhs_block);
+	heap.reserve(lhs_block);
+	block.reserve(rhs_block);
+	auto load_block = [&block, rhs_block](Reader &reader) {
+		block.clear();
+		for (; !reader.done() && block.size() < rhs_block; reader.next()) {
+			block.push_back(reader.term());
+		}
+	};
+	if (rhs_resident) {
+		Reader reader(*rhs, MIN_BUFFER);
+		load_block(reader);
+	}
+
+	const std::uint64_t products = lhs->count * rhs->count;
+	std::uint64_t done = 0;
+	std::vector<DiskPolynomial> runs;
+	for (Reader left(*lhs, MIN_BUFFER); !left.done();) {
+		rows.clear();
+		for (; !left.done() && rows.size() < lhs_block; left.next()) {
+			rows.push_back({left.term().coefficient, left.term().exponent, 0});
+		}
+		if (rhs_resident) {
+			runs.push_back(multiply_block(rows, block, heap, limits, run_buffer, !single_run));
+			done += rows.size() * block.size();
+			cancel::progress("poly dmul", done, products);
+			continue;
+		}
+		for (Reader right(*rhs, MIN_BUFFER); !right.done();) {
+			load_block(right);
+			runs.push_back(multiply_block(rows, block, heap, limits, run_buffer, true));
+			done += rows.size() * block.size();
+			cancel::progress("poly dmul", done, products);
+		}
+	}
+	if (single_run) {
+		return std::move(runs.front());
+	}
+	std::vector<double> scales(runs.size(), 1.0);
+	return merge(std::move(runs), std::move(scales), limits, "poly dmul merge");
+}
+
+double DiskPolynomial::evaluate(double x) const {
+	CALC_TRACE_SCOPE("disk_evaluate");
+	// Horner over the gaps between exponents, streamed once
+	Reader reader(*this, MIN_BUFFER);
+	if (reader.done()) {
+		return 0.0;
+	}
+	double value = reader.term().coefficient;
+	std::int64_t previous = reader.term().exponent;
+	std::size_t steps = 0;
+	for (reader.next(); !reader.done(); reader.next()) {
+		if (++steps % 4096 == 0) {
+			cancel::checkpoint();
+		}
+		auto [coefficient, exponent] = reader.term();
+		value = value * power(x, static_cast<std::uint64_t>(previous) - static_cast<std::uint64_t>(exponent)) + coefficient;
+		previous = exponent;
+	}
+	return value * power(x, previous);
+}
+
+std::string DiskPolynomial::path() const {
+	return file ? file->path : std::string();
+}
@@ -1,281 +1,284 @@
 #include "expression.hpp"
-#include "stack.hpp"
+#include "thread_pool.hpp"
 
-#include <cctype>
-#include <cstddef>
-#include <limits>
-#include <numeric>
-#include <stdexcept>
+#include <algorithm>
+#include <string_view>
+#include <vector>
 
 namespace {
 
-std::string remove_spaces(std::string expr) {
-    std::string result;
-    for (const char &ch : expr) {
-        if (!std::isspace(static_cast<unsigned char>(ch))) {
-            result.push_back(ch);
-        }
-    }
-    return result;
+// characters of operands evaluated by one task. A task costs a few
+// microseconds to queue and join; this much text takes the serial parser
+// a few hundred, so the split pays off as soon as two workers share it
+constexpr std::size_t PARALLEL_GRAIN = 32768;
+
+// the stacks of one task, reused for all of its operands
+struct Stacks {
+	Stack<Fraction> values;
+	Stack<char> operators;
+};
+
+struct irregular_expression {};
+
+struct ExprNode {
+	enum class Kind { Leaf, Sum, Product };
+
+	Kind kind = Kind::Leaf;
+	std::string_view text;
+	bool signed_product = false;    // product preceded by unary signs
+	bool negate = false;            // those signs amount to a minus
+	std::vector<char> ops;          // ops[i - 1] joins children[i - 1] and children[i]
+	std::vector<ExprNode> children;
+};
+
+bool is_binary_position(std::string_view text, std::size_t index) {
+	// '+' and '-' are binary only after an operand, just like in expression_evaluate
+	return index > 0 && (expression_detail::is_digit(text[index - 1]) || text[index - 1] == ')');
 }
 
-int precedence(char op) {
-	switch (op) {
-	case '+':
-	case '-':
-		return 1;
-	case '*':
-	case '/':
-		return 2;
-	case '^':
-		return 3;
-	default:
-		throw std::runtime_error("unknown operator");
+std::string_view strip_parentheses(std::string_view text) {
+	// drop parentheses that enclose the whole text
+	while (text.size() >= 2 && text.front() == '(' && text.back() == ')') {
+		int depth = 0;
+		std::size_t index = 0;
+		for (; index < text.size(); ++index) {
+			if (text[index] == '(') {
+				++depth;
+			} else if (text[index] == ')' && --depth == 0) {
+				break;
+			}
+		}
+		if (index != text.size() - 1) {
+			break;
+		}
+		text = text.substr(1, text.size() - 2);
 	}
+	return text;
 }
 
-bool is_unary(char op, const std::string &input, std::size_t index) {
-    return (op == '+' || op == '-') && (index == 0 || input[index - 1] == '(' || input[index - 1] == '+' || input[index - 1] == '-' || input[index - 1] == '*' || input[index - 1] == '/' || input[index - 1] == '^');
+// calls split(index) for every top-level '+'/'-' (additive) or '*'/'/'
+template <typename Split>
+void scan_top_level(std::string_view text, bool additive, Split &&split) {
+	int depth = 0;
+	for (std::size_t index = 0; index < text.size(); ++index) {
+		if (index % 4096 == 0) {
+			cancel::checkpoint();
+		}
+		char ch = text[index];
+		if (ch == '(') {
+			++depth;
+		} else if (ch == ')') {
+			if (--depth < 0) {
+				throw irregular_expression{};
+			}
+		} else if (depth == 0) {
+			if (additive ? ((ch == '+' || ch == '-') && is_binary_position(text, index)) : (ch == '*' || ch == '/')) {
+				split(index);
+			}
+		}
+	}
+	if (depth != 0) {
+		throw irregular_expression{};
+	}
 }
 
-bool is_right_associative(char op) {
-	return op == '^';
+ExprNode build_tree(std::string_view text);
+
+// a sum is cut into chunks of about PARALLEL_GRAIN characters instead of a
+// node per operand. A chunk after the first starts with the sign in front of
+// it, "-b+c", which the serial parser reads as 0 - b + c, so the chunks just
+// add up. Operands too long for one chunk get a subtree of their own.
+// false if text has no top-level '+' or '-'
+bool build_sum(std::string_view text, ExprNode &node) {
+	std::size_t chunk_begin = 0;
+	std::size_t operand_begin = 0;
+	bool split = false;
+	auto add_chunk = [&](std::size_t begin, std::size_t end) {
+		if (!node.children.empty()) {
+			node.ops.push_back('+');
+		}
+		node.children.emplace_back().text = text.substr(begin, end - begin);
+	};
+	auto end_operand = [&](std::size_t end) {
+		std::string_view operand = text.substr(operand_begin, end - operand_begin);
+		if (operand.empty() || (operand_begin > 0 && (operand.front() == '+' || operand.front() == '-'))) {
+			// a sign right after a binary operator is handled specially by the serial parser
+			throw irregular_expression{};
+		}
+		if (operand.size() >= 2 * PARALLEL_GRAIN) {
+			std::size_t sign = operand_begin > 0 ? operand_begin - 1 : 0;
+			if (sign > chunk_begin) {
+				add_chunk(chunk_begin, sign);
+			}
+			if (!node.children.empty()) {
+				node.ops.push_back(text[sign]);
+			}
+			node.children.push_back(build_tree(operand));
+			chunk_begin = end;
+		} else if (end - chunk_begin >= PARALLEL_GRAIN) {
+			add_chunk(chunk_begin, end);
+			chunk_begin = end;
+		}
+		operand_begin = end + 1;
+	};
+	scan_top_level(text, true, [&](std::size_t index) {
+		split = true;
+		end_operand(index);
+	});
+	if (!split) {
+		return false;
+	}
+	end_operand(text.size());
+	if (chunk_begin < text.size()) {
+		add_chunk(chunk_begin, text.size());
+	}
+	node.kind = ExprNode::Kind::Sum;
+	return true;
 }
 
-i64 parse_integer(const std::string &text, std::size_t &index) {
-    // parse a non-negative integer starting at text[index]
-    if (index >= text.size()) {
-        throw std::runtime_error("expected digit");
-    }
-    if (!std::isdigit(static_cast<unsigned char>(text[index]))) {
-        throw std::runtime_error("expected digit");
-    }
-    i64 value = 0;
-    while (index < text.size() && std::isdigit(static_cast<unsigned char>(text[index]))) {
-        value = value * 10 + (text[index] - '0');
-        ++index;
-    }
-    return value;
-}
+ExprNode build_tree(std::string_view text) {
+	// anything the splitter does not fully understand raises irregular_expression,
+	// and the caller falls back to the serial parser so errors stay identical
+	ExprNode node;
+	node.text = text;
+	if (text.size() < 2 * PARALLEL_GRAIN || build_sum(text, node)) {
+		return node;
+	}
 
-void apply_operator(Stack<Fraction> &values, char op) {
-    // apply operator op to the top two values on the stack
-	if (values.size() < 2) {
-		throw std::runtime_error("insufficient operands");
+	// a product; expression_evaluate turns leading signs into 0 +/- product
+	std::size_t begin = 0;
+	while (begin < text.size() && (text[begin] == '+' || text[begin] == '-')) {
+		node.negate ^= text[begin] == '-';
+		++begin;
 	}
-	Fraction rhs = values.pop();
-	Fraction lhs = values.pop();
-	switch (op) {
-	case '+':
-		values.push(lhs + rhs);
-		break;
-	case '-':
-		values.push(lhs - rhs);
-		break;
-	case '*':
-		values.push(lhs * rhs);
-		break;
-	case '/':
-		values.push(lhs / rhs);
-		break;
-	case '^':
-		if (rhs.denominator != 1) {
-			throw std::runtime_error("exponent must be integer");
+	text = text.substr(begin);
+	std::vector<std::size_t> positions;
+	scan_top_level(text, false, [&positions](std::size_t index) { positions.push_back(index); });
+	node.kind = ExprNode::Kind::Product;
+	node.signed_product = begin > 0;
+	if (positions.empty()) {
+		std::string_view inner = strip_parentheses(text);
+		if (inner.size() == text.size()) {
+			// a single factor such as 2^(...)
+			ExprNode leaf;
+			leaf.text = node.text;
+			return leaf;
 		}
-		values.push(lhs ^ static_cast<int>(rhs.numerator));
-		break;
-	default:
-		throw std::runtime_error("unknown operator");
+		node.children.push_back(build_tree(inner));
+		return node.signed_product ? node : std::move(node.children.front());
 	}
-}
 
-void process_operator(Stack<Fraction> &values, Stack<char> &operators, char op) {
-    // process operator op
-	while (!operators.empty()) {
-		char top = operators.top();
-		if (top == '(') {
-			break;
+	node.ops.reserve(positions.size());
+	node.children.reserve(positions.size() + 1);
+	begin = 0;
+	for (std::size_t i = 0; i <= positions.size(); ++i) {
+		std::size_t end = i < positions.size() ? positions[i] : text.size();
+		std::string_view operand = text.substr(begin, end - begin);
+		if (operand.empty() || (i > 0 && (operand.front() == '+' || operand.front() == '-'))) {
+			throw irregular_expression{};
 		}
-		int top_prec = precedence(top);
-		int op_prec = precedence(op);
-		if (top_prec > op_prec || (top_prec == op_prec && !is_right_associative(op))) {
-            // if top operator has higher or equal precedence, apply it first
-			operators.pop();
-			apply_operator(values, top);
-		} else {
-			break;
+		if (i > 0) {
+			node.ops.push_back(text[positions[i - 1]]);
 		}
+		node.children.push_back(build_tree(operand));
+		begin = end + 1;
 	}
-	operators.push(op);
+	return node;
 }
 
-void collapse(Stack<Fraction> &values, Stack<char> &operators) {
-    // collapse until the matching '('
-	while (!operators.empty() && operators.top() != '(') {
-		char op = operators.pop();
-		apply_operator(values, op);
+Fraction evaluate_tree(const ExprNode &node, ThreadPool &pool, Stacks &stacks) {
+	if (node.kind == ExprNode::Kind::Leaf) {
+		// the text is a slice of the input, already without spaces
+		return expression_detail::evaluate_tokens(node.text, stacks.values, stacks.operators);
 	}
-	if (operators.empty()) {
-		throw std::runtime_error("missing opening parenthesis");
+	CALC_TRACE_SCOPE(node.kind == ExprNode::Kind::Sum ? "evaluate_sum" : "evaluate_product");
+
+	// evaluate the operands in batches of roughly PARALLEL_GRAIN characters
+	std::vector<Fraction> values(node.children.size());
+	{
+		TaskGroup group(pool);
+		std::size_t begin = 0;
+		std::size_t length = 0;
+		for (std::size_t i = 0; i < node.children.size(); ++i) {
+			length += node.children[i].text.size();
+			if (length >= PARALLEL_GRAIN || i + 1 == node.children.size()) {
+				group.run([&node, &values, &pool, begin, end = i + 1] {
+					Stacks stacks;
+					for (std::size_t j = begin; j < end; ++j) {
+						values[j] = evaluate_tree(node.children[j], pool, stacks);
+					}
+				});
+				begin = i + 1;
+				length = 0;
+			}
+		}
+		group.wait();
 	}
-	operators.pop();
-}
-
-} // namespace
-
-Fraction::Fraction(i64 num, i64 denom) : numerator(num), denominator(denom) {
-    normalize();
-}
-
-void Fraction::normalize() {
-    if (denominator < 0) {
-        denominator = -denominator;
-        numerator = -numerator;
-    }
-    auto d = std::gcd(numerator, denominator);
-    numerator /= d;
-    denominator /= d;
-}
-
-Fraction operator+(const Fraction &a, const Fraction &b) {
-    return Fraction{a.numerator * b.denominator + b.numerator * a.denominator,
-                    a.denominator * b.denominator};
-}
-
-Fraction &Fraction::operator+=(const Fraction &other) {
-    *this = *this + other;
-    return *this;
-}
-
-Fraction Fraction::operator-() const {
-    return Fraction(-numerator, denominator);
-}
-
-Fraction operator-(const Fraction &a, const Fraction &b) {
-    return Fraction{a.numerator * b.denominator - b.numerator * a.denominator,
-                    a.denominator * b.denominator};
-}
-
-Fraction &Fraction::operator-=(const Fraction &other) {
-    *this = *this - other;
-    return *this;
-}
-
-Fraction operator*(const Fraction &a, const Fraction &b) {
-    return Fraction{a.numerator * b.numerator, a.denominator * b.denominator};
-}
 
-Fraction &Fraction::operator*=(const Fraction &other) {
-    *this = *this * other;
-    return *this;
-}
-
-Fraction operator/(const Fraction &a, const Fraction &b) {
-    if (b.numerator == 0) {
-        throw std::runtime_error("division by zero");
-    }
-    return Fraction{a.numerator * b.denominator, a.denominator * b.numerator};
+	// fold left to right, in the same order as the serial parser
+	Fraction result = values[0];
+	for (std::size_t i = 1; i < values.size(); ++i) {
+		switch (node.ops[i - 1]) {
+		case '+':
+			result = result + values[i];
+			break;
+		case '-':
+			result = result - values[i];
+			break;
+		case '*':
+			result = result * values[i];
+			break;
+		case '/':
+			result = result / values[i];
+			break;
+		}
+	}
+	if (node.signed_product) {
+		result = node.negate ? Fraction(0, 1) - result : Fraction(0, 1) + result;
+	}
+	return result;
 }
 
-Fraction &Fraction::operator/=(const Fraction &other) {
-    *this = *this / other;
-    return *this;
-}
+} // namespace
 
-Fraction operator^(const Fraction &base, int exponent) {
-    if (exponent == 0) {
-        return Fraction(1, 1);
-    }
-    if (base.numerator == 0 && exponent < 0) {
-        throw std::runtime_error("zero cannot be raised to negative power");
-    }
-    Fraction result(1, 1);
-    Fraction factor = base;
-    if (exponent < 0) {
-        factor = Fraction(base.denominator, base.numerator);
-        exponent = -exponent;
-    }
-    while (exponent) {
-        if (exponent & 1) {
-            result *= factor;
-        }
-        if (exponent > 1) {
-            factor *= factor;
-        }
-        exponent >>= 1;
-    }
-    return result;
+std::ostream& operator<<(std::ostream &os, const Fraction &value) {
+    os << value.numerator << '/' << value.denominator;
+    return os;
 }
 
-Fraction &Fraction::operator^=(int exponent) {
-    *this = (*this) ^ exponent;
-    return *this;
+Fraction expression_evaluate_parallel(const std::string &expr) {
+    return expression_evaluate_parallel(expr, ThreadPool::global());
 }
 
-Fraction expression_evaluate(const std::string &expr) {
-    std::string input = remove_spaces(expr);
-    if (input.empty()) {
-        throw std::runtime_error("expression is empty");
-    }
-
-    Stack<Fraction> values;
-    Stack<char> operators;
-
-    std::size_t index = 0;
-    while (index < input.size()) {
-        char ch = input[index];
-
-        if (std::isdigit(static_cast<unsigned char>(ch))) {
-            Fraction number{parse_integer(input, index), 1};
-            values.push(number);
-            continue;
-        }
-
-        if (ch == '(') {
-            operators.push('(');
-            ++index;
-            continue;
-        } else if (ch == ')') {
-            ++index;
-            collapse(values, operators);
-            continue;
-        } else {
-            if (is_unary(ch, input, index)) {
-                int count = 0;
-                while (index < input.size() && (input[index] == '+' || input[index] == '-')) {
-                    if (input[index] == '-') {
-                        ++count;
-                    }
-                    if (index > 0 && (input[index - 1] == '*' || input[index - 1] == '/' || input[index - 1] == '^')) {
-                        throw std::runtime_error("invalid use of unary operator after '*', '/' or '^'");
-                    }
-                    ++index;
-                }
-                values.push(Fraction(0, 1));
-                ch = (count % 2 == 0) ? '+' : '-';
-                --index; // adjust for the upcoming ++index
-            }
-
-            process_operator(values, operators, ch);
-            ++index;
-        }
+Fraction expression_evaluate_parallel(const std::string &expr, ThreadPool &pool) {
+    CALC_TRACE_SCOPE("expression_evaluate_parallel");
+    if (expr.size() < 2 * PARALLEL_GRAIN || pool.size() < 2) {
+        // one task could only add its own cost to the serial parser
+        return expression_evaluate(expr);
     }
-
-    while (!operators.empty()) {
-        char op = operators.pop();
-        if (op == '(' || op == ')') {
-            throw std::runtime_error("mismatched parentheses");
-        }
-        apply_operator(values, op);
+    // the operands are evaluated in place, as slices of the text without spaces
+    std::string stripped;
+    std::string_view input = expr;
+    // every space character is at most ' '; counting them vectorizes, a
+    // search for the first one does not
+    if (std::count_if(expr.begin(), expr.end(), [](char ch) { return static_cast<unsigned char>(ch) <= ' '; }) > 0) {
+        stripped = expression_detail::remove_spaces(expr);
+        input = stripped;
     }
-
-    if (values.size() != 1) {
-        throw std::runtime_error("malformed expression");
+    try {
+        ExprNode root = [&] {
+            CALC_TRACE_SCOPE("build_tree");
+            return build_tree(input);
+        }();
+        Stacks stacks;
+        return evaluate_tree(root, pool, stacks);
+    } catch (const cancel::Cancelled &) {
+        throw; // an interrupt, timeout or memory budget ends the command
+    } catch (const irregular_expression &) {
+        // the splitter cannot handle this input
+    } catch (const std::runtime_error &) {
+        // a parse or arithmetic error: the serial parser reports it in the
+        // order it finds it, which may be a different one
     }
-    return values.pop();
-}
-
-std::ostream& operator<<(std::ostream &os, const Fraction &value) {
-    os << value.numerator << '/' << value.denominator;
-    return os;
+    return expression_evaluate(expr);
 }
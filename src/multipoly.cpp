@@ -0,0 +1,553 @@
+#include "multipoly.hpp"
+#include "cancel.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+
+namespace {
+
+constexpr double EPSILON = 1e-9;
+constexpr std::uint64_t GUARD_MASK = 0x8080808080808080ULL;
+
+bool is_zero(double value) {
+	return std::abs(value) < EPSILON;
+}
+
+constexpr unsigned shift_of(std::size_t variable) {
+	return static_cast<unsigned>((MultiPolynomial::MAX_VARIABLES - 1 - variable) * 8);
+}
+
+std::uint64_t multiply_monomials(std::uint64_t a, std::uint64_t b) {
+	std::uint64_t product = a + b;
+	if (product & GUARD_MASK) {
+		throw std::overflow_error("乘积中的指数超过 127");
+	}
+	return product;
+}
+
+std::string merge_variables(const std::string &a, const std::string &b) {
+	std::string merged = a + b;
+	std::sort(merged.begin(), merged.end());
+	merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+	if (merged.size() > MultiPolynomial::MAX_VARIABLES) {
+		throw std::runtime_error("变量过多 (最多 8 个)");
+	}
+	return merged;
+}
+
+// p over the given variables, remapped into storage only when needed
+const MultiPolynomial &over(const MultiPolynomial &p, const std::string &variables, MultiPolynomial &storage) {
+	if (p.variables() == variables) {
+		return p;
+	}
+	storage = p.withVariables(variables);
+	return storage;
+}
+
+// appends a term to a list kept in descending order, combining equal monomials
+void push_term(std::vector<MultiTerm> &list, std::uint64_t monomial, double coefficient) {
+	if (!list.empty() && list.back().monomial == monomial) {
+		list.back().coefficient += coefficient;
+		if (is_zero(list.back().coefficient)) {
+			list.pop_back();
+		}
+	} else if (!is_zero(coefficient)) {
+		list.push_back({monomial, coefficient});
+	}
+}
+
+// the exponents of the product stay inside a box of prod (da_v + db_v + 1)
+// cells. When that box is small compared to the number of term products,
+// coefficients are summed in a dense array instead of merged through a heap.
+// cells are numbered in mixed radix with the first variable most significant,
+// so adding two cell numbers multiplies the monomials and descending cell
+// numbers are descending monomials
+constexpr std::size_t DENSE_CELLS_LIMIT = std::size_t{1} << 22;
+
+bool multiply_dense(const std::vector<MultiTerm> &left, const std::vector<MultiTerm> &right, std::size_t variables,
+                    std::vector<MultiTerm> &out) {
+	unsigned high_left[MultiPolynomial::MAX_VARIABLES] = {};
+	unsigned high_right[MultiPolynomial::MAX_VARIABLES] = {};
+	auto field = [](std::uint64_t monomial, std::size_t v) {
+		return static_cast<unsigned>((monomial >> shift_of(v)) & 0xFF);
+	};
+	for (const auto &term : left) {
+		for (std::size_t v = 0; v < variables; ++v) {
+			high_left[v] = std::max(high_left[v], field(term.monomial, v));
+		}
+	}
+	for (const auto &term : right) {
+		for (std::size_t v = 0; v < variables; ++v) {
+			high_right[v] = std::max(high_right[v], field(term.monomial, v));
+		}
+	}
+	std::size_t stride[MultiPolynomial::MAX_VARIABLES] = {};
+	std::size_t cells = 1;
+	for (std::size_t v = variables; v-- > 0;) {
+		if (high_left[v] + high_right[v] > MultiPolynomial::MAX_EXPONENT) {
+			throw std::overflow_error("乘积中的指数超过 127");
+		}
+		stride[v] = cells;
+		cells *= high_left[v] + high_right[v] + 1;
+		if (cells > DENSE_CELLS_LIMIT) {
+			return false;
+		}
+	}
+	const double products = static_cast<double>(left.size()) * static_cast<double>(right.size());
+	if (static_cast<double>(cells) > 4.0 * products) {
+		return false;
+	}
+
+	auto cell_of = [&](std::uint64_t monomial) {
+		std::size_t cell = 0;
+		for (std::size_t v = 0; v < variables; ++v) {
+			cell += field(monomial, v) * stride[v];
+		}
+		return cell;
+	};
+	std::vector<std::size_t> right_cells(right.size());
+	for (std::size_t j = 0; j < right.size(); ++j) {
+		right_cells[j] = cell_of(right[j].monomial);
+	}
+	// the accumulator is charged to the command first, so a budget refuses
+	// it before it is allocated
+	const auto accumulator_bytes = static_cast<std::ptrdiff_t>(cells * sizeof(double));
+	cancel::charge(accumulator_bytes);
+	cancel::checkpoint();
+	std::vector<double> sums(cells, 0.0);
+	std::size_t row = 0;
+	for (const auto &term : left) {
+		cancel::progress("poly mmul", row++, left.size());
+		double *base = sums.data() + cell_of(term.monomial);
+		for (std::size_t j = 0; j < right.size(); ++j) {
+			base[right_cells[j]] += term.coefficient * right[j].coefficient;
+		}
+	}
+	for (std::size_t cell = cells; cell-- > 0;) {
+		if (is_zero(sums[cell])) {
+			continue;
+		}
+		std::uint64_t monomial = 0;
+		std::size_t rest = cell;
+		for (std::size_t v = 0; v < variables; ++v) {
+			monomial |= static_cast<std::uint64_t>(rest / stride[v]) << shift_of(v);
+			rest %= stride[v];
+		}
+		out.push_back({monomial, sums[cell]});
+	}
+	cancel::charge(-accumulator_bytes);
+	return true;
+}
+
+} // namespace
+
+MultiPolynomial::MultiPolynomial(std::string variables) : vars(std::move(variables)) {
+	if (vars.size() > MAX_VARIABLES) {
+		throw std::runtime_error("变量过多 (最多 8 个)");
+	}
+	for (std::size_t i = 0; i < vars.size(); ++i) {
+		if (!std::islower(static_cast<unsigned char>(vars[i])) || (i > 0 && vars[i - 1] >= vars[i])) {
+			throw std::runtime_error("变量必须是互不相同且按字母顺序排列的小写字母");
+		}
+	}
+}
+
+MultiPolynomial MultiPolynomial::fromSortedTerms(std::string variables, const MultiTerm *terms, std::size_t count) {
+	MultiPolynomial result(std::move(variables));
+	// exponent fields of the variables in use, guard bits excluded
+	std::uint64_t fields = 0;
+	for (std::size_t v = 0; v < result.vars.size(); ++v) {
+		fields |= std::uint64_t{MAX_EXPONENT} << shift_of(v);
+	}
+	result.list.reserve(count);
+	for (std::size_t i = 0; i < count; ++i) {
+		if ((terms[i].monomial & ~fields) != 0) {
+			throw std::runtime_error("单项式超出变量的指数范围");
+		}
+		if (i > 0 && terms[i].monomial >= terms[i - 1].monomial) {
+			throw std::runtime_error("项未按单项式降序排列");
+		}
+		if (!is_zero(terms[i].coefficient)) {
+			result.list.push_back(terms[i]);
+		}
+	}
+	return result;
+}
+
+MultiPolynomial MultiPolynomial::parse(const std::string &text) {
+	// collect (coefficient, letter exponents) first, the variable set is
+	// only known at the end
+	struct Parsed {
+		double coefficient;
+		unsigned exponents[26];
+	};
+	std::vector<Parsed> parsed;
+	std::string letters;
+	std::size_t i = 0;
+	auto skip_spaces = [&] {
+		while (i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) {
+			++i;
+		}
+	};
+	auto read_unsigned = [&] {
+		std::size_t begin = i;
+		unsigned long value = 0;
+		while (i < text.size() && std::isdigit(static_cast<unsigned char>(text[i]))) {
+			value = value * 10 + static_cast<unsigned long>(text[i] - '0');
+			if (value > MAX_EXPONENT) {
+				throw std::runtime_error("指数超过 127");
+			}
+			++i;
+		}
+		if (i == begin) {
+			throw std::runtime_error("'^' 后缺少指数");
+		}
+		return static_cast<unsigned>(value);
+	};
+
+	skip_spaces();
+	if (i == text.size()) {
+		throw std::runtime_error("多项式为空");
+	}
+	bool first = true;
+	while (true) {
+		skip_spaces();
+		if (i == text.size()) {
+			break;
+		}
+		double sign = 1.0;
+		if (text[i] == '+' || text[i] == '-') {
+			sign = text[i] == '-' ? -1.0 : 1.0;
+			++i;
+			skip_spaces();
+		} else if (!first) {
+			throw std::runtime_error(std::format("意外的字符 '{}'", text[i]));
+		}
+		first = false;
+
+		Parsed term{sign, {}};
+		bool has_factor = false;
+		if (i < text.size() && (std::isdigit(static_cast<unsigned char>(text[i])) || text[i] == '.')) {
+			std::size_t used = 0;
+			try {
+				term.coefficient *= std::stod(text.substr(i), &used);
+			} catch (const std::exception &) {
+				throw std::runtime_error("系数格式错误");
+			}
+			i += used;
+			has_factor = true;
+		}
+		while (true) {
+			skip_spaces();
+			if (i < text.size() && text[i] == '*') {
+				++i;
+				skip_spaces();
+			}
+			if (i == text.size() || !std::islower(static_cast<unsigned char>(text[i]))) {
+				break;
+			}
+			char letter = text[i++];
+			unsigned power = 1;
+			if (i < text.size() && text[i] == '^') {
+				++i;
+				power = read_unsigned();
+			}
+			unsigned &slot = term.exponents[letter - 'a'];
+			if (slot + power > MAX_EXPONENT) {
+				throw std::runtime_error("指数超过 127");
+			}
+			slot += power;
+			if (letters.find(letter) == std::string::npos) {
+				letters += letter;
+			}
+			has_factor = true;
+		}
+		if (!has_factor) {
+			throw std::runtime_error("缺少项");
+		}
+		parsed.push_back(term);
+	}
+
+	std::sort(letters.begin(), letters.end());
+	MultiPolynomial result(letters);
+	std::vector<unsigned> exponents(letters.size());
+	for (const auto &term : parsed) {
+		for (std::size_t v = 0; v < letters.size(); ++v) {
+			exponents[v] = term.exponents[letters[v] - 'a'];
+		}
+		result.addTerm(term.coefficient, exponents);
+	}
+	return result;
+}
+
+void MultiPolynomial::addTerm(double coefficient, const std::vector<unsigned> &exponents) {
+	if (exponents.size() != vars.size()) {
+		throw std::runtime_error("指数个数与变量个数不符");
+	}
+	std::uint64_t monomial = 0;
+	for (std::size_t v = 0; v < exponents.size(); ++v) {
+		if (exponents[v] > MAX_EXPONENT) {
+			throw std::overflow_error("指数超过 127");
+		}
+		monomial |= static_cast<std::uint64_t>(exponents[v]) << shift_of(v);
+	}
+	// binary search for the slot, the vector stays sorted
+	auto it = std::lower_bound(list.begin(), list.end(), monomial,
+	                           [](const MultiTerm &term, std::uint64_t m) { return term.monomial > m; });
+	if (it != list.end() && it->monomial == monomial) {
+		it->coefficient += coefficient;
+		if (is_zero(it->coefficient)) {
+			list.erase(it);
+		}
+	} else if (!is_zero(coefficient)) {
+		list.insert(it, {monomial, coefficient});
+	}
+}
+
+MultiPolynomial MultiPolynomial::withVariables(const std::string &variables) const {
+	if (variables == vars) {
+		return *this;
+	}
+	MultiPolynomial result(variables);
+	// where every current variable moves to; the order of the fields is kept
+	// because both variable lists are sorted, so the terms stay sorted
+	std::vector<std::size_t> target(vars.size());
+	for (std::size_t v = 0; v < vars.size(); ++v) {
+		auto position = variables.find(vars[v]);
+		if (position == std::string::npos) {
+			throw std::runtime_error(std::format("新的变量表中缺少变量 {}", vars[v]));
+		}
+		target[v] = position;
+	}
+	result.list.reserve(list.size());
+	for (const auto &term : list) {
+		std::uint64_t monomial = 0;
+		for (std::size_t v = 0; v < vars.size(); ++v) {
+			monomial |= static_cast<std::uint64_t>(exponent(term.monomial, v)) << shift_of(target[v]);
+		}
+		result.list.push_back({monomial, term.coefficient});
+	}
+	return result;
+}
+
+MultiPolynomial operator+(const MultiPolynomial &a, const MultiPolynomial &b) {
+	CALC_TRACE_SCOPE("multi_add");
+	std::string variables = merge_variables(a.vars, b.vars);
+	MultiPolynomial lhs_storage, rhs_storage;
+	const MultiPolynomial &lhs = over(a, variables, lhs_storage);
+	const MultiPolynomial &rhs = over(b, variables, rhs_storage);
+	MultiPolynomial result(variables);
+	result.list.reserve(lhs.list.size() + rhs.list.size());
+	// merge of two descending runs
+	auto i = lhs.list.begin(), j = rhs.list.begin();
+	while (i != lhs.list.end() || j != rhs.list.end()) {
+		if (j == rhs.list.end() || (i != lhs.list.end() && i->monomial > j->monomial)) {
+			push_term(result.list, i->monomial, i->coefficient);
+			++i;
+		} else if (i == lhs.list.end() || j->monomial > i->monomial) {
+			push_term(result.list, j->monomial, j->coefficient);
+			++j;
+		} else {
+			push_term(result.list, i->monomial, i->coefficient + j->coefficient);
+			++i;
+			++j;
+		}
+	}
+	return result;
+}
+
+MultiPolynomial MultiPolynomial::operator-() const {
+	MultiPolynomial result = *this;
+	for (auto &term : result.list) {
+		term.coefficient = -term.coefficient;
+	}
+	return result;
+}
+
+MultiPolynomial operator-(const MultiPolynomial &a, const MultiPolynomial &b) {
+	return a + (-b);
+}
+
+MultiPolynomial operator*(const MultiPolynomial &a, const MultiPolynomial &b) {
+	CALC_TRACE_SCOPE("multi_mul");
+	std::string variables = merge_variables(a.vars, b.vars);
+	MultiPolynomial a_storage, b_storage;
+	const MultiPolynomial *lhs = &over(a, variables, a_storage);
+	const MultiPolynomial *rhs = &over(b, variables, b_storage);
+	if (lhs->list.size() > rhs->list.size()) {
+		std::swap(lhs, rhs);
+	}
+	const std::vector<MultiTerm> &left = lhs->list;
+	const std::vector<MultiTerm> &right = rhs->list;
+	MultiPolynomial result(variables);
+	if (left.empty()) {
+		return result;
+	}
+	if (multiply_dense(left, right, variables.size(), result.list)) {
+		return result;
+	}
+	// adding a monomial keeps a run in order, so left[i] * right is a sorted
+	// run for every i. A max-heap over the heads of those runs yields the
+	// products in descending order (Johnson's method): no intermediate term
+	// lists, and the heap holds one entry per term of the shorter factor.
+	// the next product of a run replaces the top in place, one sift-down
+	// instead of a pop and a push
+	struct Head {
+		std::uint64_t monomial;
+		std::uint32_t i, j;
+	};
+	std::vector<Head> heap;
+	heap.reserve(left.size());
+	for (std::size_t i = 0; i < left.size(); ++i) {
+		// products of the first term of right arrive in descending order,
+		// so appending keeps the array a valid heap
+		heap.push_back({multiply_monomials(left[i].monomial, right[0].monomial), static_cast<std::uint32_t>(i), 0});
+	}
+	auto sift_down = [&heap](std::size_t slot) {
+		const std::size_t size = heap.size();
+		Head moving = heap[slot];
+		while (true) {
+			std::size_t child = 2 * slot + 1;
+			if (child >= size) {
+				break;
+			}
+			if (child + 1 < size && heap[child + 1].monomial > heap[child].monomial) {
+				++child;
+			}
+			if (heap[child].monomial <= moving.monomial) {
+				break;
+			}
+			heap[slot] = heap[child];
+			slot = child;
+		}
+		heap[slot] = moving;
+	};
+	const std::size_t products = left.size() * right.size();
+	std::size_t done = 0;
+	while (!heap.empty()) {
+		if (++done % 4096 == 0) {
+			cancel::progress("poly mmul", done, products);
+		}
+		Head &top = heap.front();
+		push_term(result.list, top.monomial, left[top.i].coefficient * right[top.j].coefficient);
+		if (top.j + 1 < right.size()) {
+			++top.j;
+			top.monomial = multiply_monomials(left[top.i].monomial, right[top.j].monomial);
+		} else {
+			top = heap.back();
+			heap.pop_back();
+		}
+		if (!heap.empty()) {
+			sift_down(0);
+		}
+	}
+	return result;
+}
+
+double MultiPolynomial::evaluate(const std::vector<double> &values) const {
+	CALC_TRACE_SCOPE("multi_evaluate");
+	if (values.size() != vars.size()) {
+		throw std::runtime_error("取值个数与变量个数不符");
+	}
+	// powers[v][e] = values[v]^e, filled up to the largest exponent used
+	std::vector<std::vector<double>> powers(vars.size(), std::vector<double>{1.0});
+	for (const auto &term : list) {
+		for (std::size_t v = 0; v < vars.size(); ++v) {
+			auto &table = powers[v];
+			for (unsigned e = static_cast<unsigned>(table.size()); e <= exponent(term.monomial, v); ++e) {
+				table.push_back(table.back() * values[v]);
+			}
+		}
+	}
+	double result = 0.0;
+	for (const auto &term : list) {
+		double value = term.coefficient;
+		for (std::size_t v = 0; v < vars.size(); ++v) {
+			value *= powers[v][exponent(term.monomial, v)];
+		}
+		result += value;
+	}
+	return result;
+}
+
+MultiPolynomial MultiPolynomial::partialDerivative(char variable) const {
+	CALC_TRACE_SCOPE("multi_derivative");
+	MultiPolynomial result(vars);
+	auto position = vars.find(variable);
+	if (position == std::string::npos) {
+		return result; // constant in that variable
+	}
+	// subtracting the same unit from every surviving monomial keeps the order
+	const std::uint64_t unit = std::uint64_t{1} << shift_of(position);
+	for (const auto &term : list) {
+		unsigned e = exponent(term.monomial, position);
+		if (e > 0) {
+			result.list.push_back({term.monomial - unit, term.coefficient * e});
+		}
+	}
+	return result;
+}
+
+const std::string &MultiPolynomial::variables() const {
+	return vars;
+}
+
+const std::vector<MultiTerm> &MultiPolynomial::terms() const {
+	return list;
+}
+
+std::size_t MultiPolynomial::termCount() const {
+	return list.size();
+}
+
+MemoryUsage MultiPolynomial::memoryUsage() const {
+	MemoryUsage usage;
+	if (list.capacity() > 0) {
+		usage.bytes = list.capacity() * sizeof(MultiTerm);
+		usage.overhead = allocation_overhead(list.data(), usage.bytes);
+	}
+	return usage;
+}
+
+unsigned MultiPolynomial::exponent(std::uint64_t monomial, std::size_t variable) const {
+	return static_cast<unsigned>((monomial >> shift_of(variable)) & 0xFF);
+}
+
+void MultiPolynomial::print(std::ostream &os) const {
+	CALC_TRACE_SCOPE("multi_print");
+	if (list.empty()) {
+		os << 0 << std::endl;
+		return;
+	}
+	bool first = true;
+	for (const auto &term : list) {
+		double coefficient = term.coefficient;
+		if (first) {
+			if (coefficient < 0) {
+				os << '-';
+			}
+		} else {
+			os << (coefficient < 0 ? " - " : " + ");
+		}
+		first = false;
+		coefficient = std::abs(coefficient);
+		bool constant = (term.monomial == 0);
+		if (constant || coefficient != 1.0) {
+			os << coefficient;
+		}
+		for (std::size_t v = 0; v < vars.size(); ++v) {
+			unsigned e = exponent(term.monomial, v);
+			if (e > 0) {
+				os << vars[v];
+				if (e > 1) {
+					os << '^' << e;
+				}
+			}
+		}
+	}
+	os << std::endl;
+}
@@ -0,0 +1,344 @@
+#include "poly_calc.hpp"
+#include "cancel.hpp"
+#include "trace.hpp"
+
+#include <bit>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// deeper nesting is rejected instead of overflowing the stack
+constexpr int MAX_DEPTH = 1000;
+
+enum class Op { Leaf, Constant, Add, Negate, Multiply, Derivative };
+
+struct Node {
+	Op op;
+	int lhs = -1;
+	int rhs = -1;
+	std::string name;     // Leaf
+	double value = 0.0;   // Constant
+};
+
+Node make_node(Op op, int lhs = -1, int rhs = -1) {
+	return Node{op, lhs, rhs, {}, 0.0};
+}
+
+// operation DAG with hash-consing: building a node that already exists
+// returns the existing one. Add and Multiply are commutative, their
+// operands are ordered so a + b and b + a share a node
+class Dag {
+public:
+	explicit Dag(const PolyLookup &lookup) : lookup_(lookup) {}
+
+	std::vector<Node> nodes;
+	std::vector<PolyHandle> leaves; // parallel to nodes, set for Leaf
+	std::size_t reused = 0;
+
+	int leaf(const std::string &name) {
+		Node node = make_node(Op::Leaf);
+		node.name = name;
+		std::size_t before = nodes.size();
+		int id = intern(std::move(node));
+		if (nodes.size() != before) {
+			leaves[id] = lookup_(name);
+		}
+		return id;
+	}
+	int constant(double value) {
+		Node node = make_node(Op::Constant);
+		node.value = value;
+		return intern(std::move(node));
+	}
+	int add(int a, int b) {
+		return intern(make_node(Op::Add, std::min(a, b), std::max(a, b)));
+	}
+	int negate(int a) {
+		if (nodes[a].op == Op::Negate) {
+			return nodes[a].lhs;
+		}
+		return intern(make_node(Op::Negate, a));
+	}
+	int multiply(int a, int b) {
+		return intern(make_node(Op::Multiply, std::min(a, b), std::max(a, b)));
+	}
+	int derivative(int a) {
+		return intern(make_node(Op::Derivative, a));
+	}
+
+private:
+	const PolyLookup &lookup_;
+	std::unordered_map<std::string, int> index_;
+
+	int intern(Node node) {
+		std::string key = std::to_string(static_cast<int>(node.op)) + ':' + std::to_string(node.lhs) + ':'
+		                + std::to_string(node.rhs) + ':' + node.name + ':'
+		                + std::to_string(std::bit_cast<std::uint64_t>(node.value));
+		auto [it, inserted] = index_.emplace(std::move(key), static_cast<int>(nodes.size()));
+		if (!inserted) {
+			++reused;
+			return it->second;
+		}
+		nodes.push_back(std::move(node));
+		leaves.emplace_back();
+		return it->second;
+	}
+};
+
+class Parser {
+public:
+	Parser(const std::string &text, Dag &dag) : text_(text), dag_(dag) {}
+
+	int parse() {
+		int root = expression(0);
+		skip_spaces();
+		if (pos_ != text_.size()) {
+			fail(std::format("意外的字符 '{}'", text_[pos_]));
+		}
+		return root;
+	}
+
+private:
+	const std::string &text_;
+	Dag &dag_;
+	std::size_t pos_ = 0;
+
+	[[noreturn]] void fail(const std::string &message) const {
+		throw std::runtime_error(std::format("{} (第 {} 个字符)", message, pos_ + 1));
+	}
+	void skip_spaces() {
+		while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+			++pos_;
+		}
+	}
+	bool accept(char ch) {
+		skip_spaces();
+		if (pos_ < text_.size() && text_[pos_] == ch) {
+			++pos_;
+			return true;
+		}
+		return false;
+	}
+
+	int expression(int depth) {
+		if (depth > MAX_DEPTH) {
+			fail("表达式嵌套过深");
+		}
+		int result = term(depth);
+		while (true) {
+			if (accept('+')) {
+				result = dag_.add(result, term(depth));
+			} else if (accept('-')) {
+				result = dag_.add(result, dag_.negate(term(depth)));
+			} else {
+				return result;
+			}
+		}
+	}
+	int term(int depth) {
+		int result = unary(depth);
+		while (accept('*')) {
+			result = dag_.multiply(result, unary(depth));
+		}
+		return result;
+	}
+	int unary(int depth) {
+		if (accept('-')) {
+			if (depth > MAX_DEPTH) {
+				fail("表达式嵌套过深");
+			}
+			return dag_.negate(unary(depth + 1));
+		}
+		int result = primary(depth);
+		while (accept('\'')) {
+			result = dag_.derivative(result);
+		}
+		return result;
+	}
+	int primary(int depth) {
+		skip_spaces();
+		if (pos_ == text_.size()) {
+			fail("表达式不完整");
+		}
+		char ch = text_[pos_];
+		if (ch == '(') {
+			++pos_;
+			int inner = expression(depth + 1);
+			if (!accept(')')) {
+				fail("缺少 ')'");
+			}
+			return inner;
+		}
+		if (std::isdigit(static_cast<unsigned char>(ch)) || ch == '.') {
+			const char *begin = text_.c_str() + pos_;
+			char *end = nullptr;
+			double value = std::strtod(begin, &end);
+			if (end == begin) {
+				fail("数字格式错误");
+			}
+			pos_ += static_cast<std::size_t>(end - begin);
+			return dag_.constant(value);
+		}
+		if (std::isalpha(static_cast<unsigned char>(ch)) || ch == '_') {
+			std::size_t begin = pos_;
+			while (pos_ < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[pos_])) || text_[pos_] == '_')) {
+				++pos_;
+			}
+			return dag_.leaf(text_.substr(begin, pos_ - begin));
+		}
+		fail(std::format("意外的字符 '{}'", ch));
+	}
+};
+
+class Evaluator {
+public:
+	Evaluator(const Dag &dag, int root) : dag_(dag), uses_(dag.nodes.size(), 0), values_(dag.nodes.size()) {
+		// count consumers over the part of the DAG reachable from root
+		std::vector<bool> seen(dag.nodes.size(), false);
+		std::vector<int> stack{root};
+		seen[root] = true;
+		while (!stack.empty()) {
+			const Node &node = dag_.nodes[stack.back()];
+			stack.pop_back();
+			for (int child : {node.lhs, node.rhs}) {
+				if (child < 0) {
+					continue;
+				}
+				++uses_[child];
+				if (!seen[child]) {
+					seen[child] = true;
+					stack.push_back(child);
+				}
+			}
+		}
+		++uses_[root];
+		for (bool reachable : seen) {
+			nodes += reachable;
+		}
+	}
+
+	Polynomial result(int root) {
+		const Polynomial &value = get(root);
+		if (values_[root]) {
+			return std::move(*values_[root]);
+		}
+		return value; // a bare name: copy the stored polynomial
+	}
+
+	std::size_t nodes = 0;
+	std::size_t fused = 0;
+
+private:
+	const Dag &dag_;
+	std::vector<int> uses_;
+	std::vector<std::optional<Polynomial>> values_;
+
+	const Polynomial &get(int id) {
+		const Node &node = dag_.nodes[id];
+		if (node.op == Op::Leaf) {
+			return *dag_.leaves[id];
+		}
+		if (!values_[id]) {
+			values_[id] = compute(id);
+		}
+		return *values_[id];
+	}
+
+	// a consumer is done with id; the value is dropped after the last one
+	void release(int id) {
+		if (--uses_[id] == 0) {
+			values_[id].reset();
+		}
+	}
+
+	// flattens a tree of Add and Negate nodes into signed operands; inner
+	// nodes with other consumers stay whole so their value can be shared
+	void collect(int id, double sign, bool top, std::map<int, double> &operands) {
+		const Node &node = dag_.nodes[id];
+		bool own = top || uses_[id] == 1;
+		if (own && node.op == Op::Add) {
+			if (!top) {
+				++fused;
+			}
+			collect(node.lhs, sign, false, operands);
+			collect(node.rhs, sign, false, operands);
+			return;
+		}
+		if (own && node.op == Op::Negate && !top) {
+			collect(node.lhs, -sign, false, operands);
+			return;
+		}
+		operands[id] += sign;
+	}
+
+	Polynomial compute(int id) {
+		cancel::checkpoint();
+		const Node &node = dag_.nodes[id];
+		switch (node.op) {
+		case Op::Constant: {
+			Polynomial constant;
+			constant.addTerm(node.value, 0);
+			return constant;
+		}
+		case Op::Add: {
+			CALC_TRACE_SCOPE("calc_sum");
+			std::map<int, double> operands; // a + a arrives here as 2a
+			collect(id, 1.0, true, operands);
+			std::vector<const Polynomial *> polys;
+			std::vector<double> scales;
+			for (const auto &[operand, scale] : operands) {
+				polys.push_back(&get(operand));
+				scales.push_back(scale);
+			}
+			Polynomial sum = Polynomial::linearCombination(polys, scales);
+			for (const auto &entry : operands) {
+				release(entry.first);
+			}
+			return sum;
+		}
+		case Op::Negate: {
+			Polynomial negated = -get(node.lhs);
+			release(node.lhs);
+			return negated;
+		}
+		case Op::Multiply: {
+			Polynomial product = get(node.lhs) * get(node.rhs);
+			release(node.lhs);
+			release(node.rhs);
+			return product;
+		}
+		case Op::Derivative: {
+			Polynomial derivative = get(node.lhs).derivative();
+			release(node.lhs);
+			return derivative;
+		}
+		case Op::Leaf:
+			break;
+		}
+		throw std::logic_error("leaf nodes are not computed");
+	}
+};
+
+} // namespace
+
+Polynomial poly_calc(const std::string &expression, const PolyLookup &lookup, PolyCalcStats *stats) {
+	CALC_TRACE_SCOPE("poly_calc");
+	Dag dag(lookup);
+	int root = Parser(expression, dag).parse();
+	Evaluator evaluator(dag, root);
+	Polynomial result = evaluator.result(root);
+	if (stats) {
+		stats->nodes = evaluator.nodes;
+		stats->reused = dag.reused;
+		stats->fused = evaluator.fused;
+	}
+	return result;
+}
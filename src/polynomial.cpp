@@ -1,7 +1,14 @@
 #include "polynomial.hpp"
+#include "cancel.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 
+#include <climits>
 #include <format>
 #include <iostream>
+#include <queue>
+#include <stdexcept>
+#include <utility>
 
 namespace {
 
@@ -11,6 +18,35 @@ bool is_zero(double value) {
 	return std::abs(value) < EPSILON;
 }
 
+// every node is created and destroyed here, so the counters and the
+// memory charged to the running command stay in step
+PolyTerm *new_term(double coefficient, int exponent, PolyTerm *next) {
+	CALC_STAT_ADD(TermAllocations, 1);
+	PolyTerm *node = new PolyTerm{coefficient, exponent, next};
+	cancel::charge(sizeof(PolyTerm));
+	return node;
+}
+
+void free_term(PolyTerm *node) {
+	CALC_STAT_ADD(TermFrees, 1);
+	delete node;
+	cancel::charge(-static_cast<std::ptrdiff_t>(sizeof(PolyTerm)));
+}
+
+// the nodes of a compacted polynomial, counted like single ones
+PolyTerm *new_block(std::size_t count) {
+	CALC_STAT_ADD(TermAllocations, count);
+	PolyTerm *block = new PolyTerm[count];
+	cancel::charge(static_cast<std::ptrdiff_t>(count * sizeof(PolyTerm)));
+	return block;
+}
+
+void free_block(PolyTerm *block, std::size_t count) {
+	CALC_STAT_ADD(TermFrees, count);
+	delete[] block;
+	cancel::charge(-static_cast<std::ptrdiff_t>(count * sizeof(PolyTerm)));
+}
+
 PolyTerm *copy_terms(const PolyTerm *source) {
 	// copy all terms after source (inclusive)
 	if (!source) {
@@ -19,7 +55,7 @@ PolyTerm *copy_terms(const PolyTerm *source) {
 	PolyTerm *head = nullptr;
 	PolyTerm **tail = &head;
 	while (source) {
-		*tail = new PolyTerm{source->coefficient, source->exponent, nullptr};
+		*tail = new_term(source->coefficient, source->exponent, nullptr);
 		tail = &((*tail)->next);
 		source = source->next;
 	}
@@ -29,6 +65,8 @@ PolyTerm *copy_terms(const PolyTerm *source) {
 void insert_term(PolyTerm *&head, double coefficient, int exponent) {
 	// insert term to the list
 	// while keeping the list sorted by exponent in descending order
+	CALC_TRACE_SCOPE("insert_term");
+	CALC_STAT_ADD(TermInserts, 1);
 	if (is_zero(coefficient)) {
 		return;
 	}
@@ -43,12 +81,12 @@ void insert_term(PolyTerm *&head, double coefficient, int exponent) {
 		if (is_zero((*current)->coefficient)) {
 			PolyTerm *to_delete = *current;
 			*current = (*current)->next;
-			delete to_delete;
+			free_term(to_delete);
 		}
 		return;
 	}
 
-	PolyTerm *node = new PolyTerm{coefficient, exponent, *current};
+	PolyTerm *node = new_term(coefficient, exponent, *current);
 	*current = node;
 }
 
@@ -65,11 +103,20 @@ void delete_terms(PolyTerm *node) {
 	// delete all terms after node (inclusive)
 	while (node) {
 		PolyTerm *next = node->next;
-		delete node;
+		free_term(node);
 		node = next;
 	}
 }
 
+// exponents are ints; a sum outside their range throws instead of wrapping
+int add_exponents(int a, int b) {
+	long long sum = static_cast<long long>(a) + b;
+	if (sum < INT_MIN || sum > INT_MAX) {
+		throw std::runtime_error("指数超出 int 范围");
+	}
+	return static_cast<int>(sum);
+}
+
 double power(double base, int exp) {
 	if (exp < 0) {
 		base = 1.0 / base;
@@ -90,13 +137,20 @@ Polynomial::Polynomial() : head(nullptr) {}
 
 Polynomial::Polynomial(const Polynomial &other) : head(copy_terms(other.head)) {}
 
-Polynomial::Polynomial(Polynomial &&other) noexcept : head(other.head) {
+Polynomial::Polynomial(Polynomial &&other) noexcept
+	: head(other.head), block(other.block), evaluator(other.evaluator.exchange(nullptr, std::memory_order_relaxed)) {
 	other.head = nullptr;
+	other.block = nullptr;
 }
 
 Polynomial::~Polynomial() {
-	delete_terms(head);
+	if (block) {
+		free_block(block, count_terms(head));
+	} else {
+		delete_terms(head);
+	}
 	head = nullptr;
+	delete evaluator.load(std::memory_order_relaxed);
 }
 
 Polynomial &Polynomial::operator=(Polynomial other) noexcept {
@@ -108,11 +162,33 @@ void swap(Polynomial &a, Polynomial &b) noexcept {
 	auto tmp = a.head;
 	a.head = b.head;
 	b.head = tmp;
+	std::swap(a.block, b.block);
+	// the cached evaluators follow their terms; swapping needs exclusive
+	// access to both, like any other change
+	const PreparedEvaluator *cached = a.evaluator.load(std::memory_order_relaxed);
+	a.evaluator.store(b.evaluator.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	b.evaluator.store(cached, std::memory_order_relaxed);
+}
+
+// every change of the terms of an existing polynomial goes through here:
+// the cached evaluator is dropped, and nodes of a block are copied out so
+// that single ones can be inserted and freed
+void Polynomial::before_change() {
+	delete evaluator.exchange(nullptr, std::memory_order_relaxed);
+	if (block) {
+		PolyTerm *nodes = copy_terms(head);
+		free_block(block, count_terms(head));
+		head = nodes;
+		block = nullptr;
+	}
 }
 
 Polynomial &Polynomial::operator+=(const Polynomial &other) {
+	CALC_TRACE_SCOPE("operator+=");
+	before_change();
 	const PolyTerm *node = other.head;
 	while (node) {
+		cancel::checkpoint(); // every insert walks the list, the loop is quadratic
 		insert_term(head, node->coefficient, node->exponent);
 		node = node->next;
 	}
@@ -123,6 +199,7 @@ Polynomial Polynomial::operator-() const {
 	Polynomial result;
 	const PolyTerm *node = head;
 	while (node) {
+		cancel::checkpoint();
 		insert_term(result.head, -node->coefficient, node->exponent);
 		node = node->next;
 	}
@@ -140,6 +217,7 @@ Polynomial &Polynomial::operator*=(const Polynomial &other) {
 }
 
 double Polynomial::evaluate(double x) const {
+	CALC_TRACE_SCOPE("evaluate");
 	double result = 0.0;
 	const PolyTerm *node = head;
 	while (node) {
@@ -150,40 +228,44 @@ double Polynomial::evaluate(double x) const {
 }
 
 Polynomial Polynomial::derivative() const {
+	CALC_TRACE_SCOPE("derivative");
 	Polynomial result;
 	const PolyTerm *node = head;
 	while (node) {
+		cancel::checkpoint();
 		if (node->exponent != 0) {
-			insert_term(result.head, node->coefficient * node->exponent, node->exponent - 1);
+			insert_term(result.head, node->coefficient * node->exponent, add_exponents(node->exponent, -1));
 		}
 		node = node->next;
 	}
 	return result;
 }
 
-void Polynomial::print() const {
+void Polynomial::print(std::ostream &os) const {
+	CALC_TRACE_SCOPE("print");
 	if (!head) {
-		std::cout << 0 << std::endl;
+		os << 0 << std::endl;
 		return;
 	}
 
 	std::size_t term_count = count_terms(head);
-	std::cout << term_count;
+	os << term_count;
 	const PolyTerm *node = head;
 	while (node) {
-		std::cout << ' ' << node->coefficient << ' ' << node->exponent;
+		os << ' ' << node->coefficient << ' ' << node->exponent;
 		node = node->next;
 	}
-	std::cout << std::endl;
+	os << std::endl;
 }
 
-void Polynomial::printLaTeX() const {
+void Polynomial::printLaTeX(std::ostream &os) const {
+	CALC_TRACE_SCOPE("printLaTeX");
 	if (!head) {
-		std::cout << "$0$" << std::endl;
+		os << "$0$" << std::endl;
 		return;
 	}
 
-	std::cout << "$";
+	os << "$";
 
 	const PolyTerm *node = head;
 	bool first = true;
@@ -193,29 +275,29 @@ void Polynomial::printLaTeX() const {
 
 		if (first) {
 			if (coeff < 0) {
-				std::cout << "-";
+				os << "-";
 			}
 		} else {
-			std::cout << (coeff < 0 ? " - " : " + ");
+			os << (coeff < 0 ? " - " : " + ");
 		}
 
 		double abs_coeff = std::abs(coeff);
 		bool omit_coeff = is_zero(abs_coeff - 1.0) && exponent != 0;
 		if (!omit_coeff || exponent == 0) {
-			std::cout << std::format("{:g}", abs_coeff);
+			os << std::format("{:g}", abs_coeff);
 		}
 
 		if (exponent != 0) {
-			std::cout << "x";
+			os << "x";
 			if (exponent != 1) {
-				std::cout << std::format("^{{{}}}", exponent);
+				os << std::format("^{{{}}}", exponent);
 			}
 		}
 
 		first = false;
 		node = node->next;
 	}
-	std::cout << "$" << std::endl;
+	os << "$" << std::endl;
 }
 
 Polynomial operator+(const Polynomial &a, const Polynomial &b) {
@@ -229,27 +311,136 @@ Polynomial operator-(const Polynomial &a, const Polynomial &b) {
 }
 
 Polynomial operator*(const Polynomial &a, const Polynomial &b) {
+	CALC_TRACE_SCOPE("operator*");
 	Polynomial result;
+	std::size_t rows = cancel::current ? count_terms(a.head) : 0;
+	std::size_t row = 0;
 	for (const PolyTerm *pa = a.head; pa; pa = pa->next) {
+		cancel::progress("poly mul", row++, rows);
 		for (const PolyTerm *pb = b.head; pb; pb = pb->next) {
-			insert_term(result.head, pa->coefficient * pb->coefficient, pa->exponent + pb->exponent);
+			insert_term(result.head, pa->coefficient * pb->coefficient, add_exponents(pa->exponent, pb->exponent));
 		}
 	}
 	return result;
 }
 
 void Polynomial::addTerm(double coefficient, int exponent) {
+	before_change();
 	insert_term(head, coefficient, exponent);
 }
 
-Polynomial createPoly() {
+Polynomial Polynomial::fromSortedTerms(const double *coefficients, const int *exponents, std::size_t count) {
+	Polynomial result;
+	PolyTerm **tail = &result.head;
+	for (std::size_t i = 0; i < count; ++i) {
+		if (i > 0 && exponents[i] >= exponents[i - 1]) {
+			throw std::runtime_error("项未按指数降序排列");
+		}
+		if (is_zero(coefficients[i])) {
+			continue;
+		}
+		*tail = new_term(coefficients[i], exponents[i], nullptr);
+		tail = &((*tail)->next);
+	}
+	return result;
+}
+
+Polynomial Polynomial::linearCombination(const std::vector<const Polynomial *> &polys, const std::vector<double> &scales) {
+	CALC_TRACE_SCOPE("linearCombination");
+	if (polys.size() != scales.size()) {
+		throw std::runtime_error("多项式与系数的个数不符");
+	}
+	// max-heap of the current head of every list, keyed by exponent
+	using Head = std::pair<int, std::size_t>;
+	std::vector<const PolyTerm *> cursor(polys.size());
+	std::priority_queue<Head> heads;
+	for (std::size_t i = 0; i < polys.size(); ++i) {
+		cursor[i] = polys[i]->head;
+		if (cursor[i]) {
+			heads.push({cursor[i]->exponent, i});
+		}
+	}
+
+	Polynomial result;
+	PolyTerm **tail = &result.head;
+	std::size_t steps = 0;
+	while (!heads.empty()) {
+		if (++steps % 4096 == 0) {
+			cancel::checkpoint();
+		}
+		int exponent = heads.top().first;
+		double coefficient = 0.0;
+		// drain every list whose head has this exponent
+		while (!heads.empty() && heads.top().first == exponent) {
+			std::size_t i = heads.top().second;
+			heads.pop();
+			coefficient += scales[i] * cursor[i]->coefficient;
+			cursor[i] = cursor[i]->next;
+			if (cursor[i]) {
+				heads.push({cursor[i]->exponent, i});
+			}
+		}
+		if (is_zero(coefficient)) {
+			continue;
+		}
+		*tail = new_term(coefficient, exponent, nullptr);
+		tail = &((*tail)->next);
+	}
+	return result;
+}
+
+const PolyTerm *Polynomial::terms() const {
+	return head;
+}
+
+std::size_t Polynomial::termCount() const {
+	return count_terms(head);
+}
+
+MemoryUsage Polynomial::memoryUsage() const {
+	MemoryUsage usage;
+	if (block) {
+		usage.bytes = count_terms(head) * sizeof(PolyTerm);
+		usage.overhead = allocation_overhead(block, usage.bytes);
+	} else {
+		for (const PolyTerm *node = head; node; node = node->next) {
+			usage.bytes += sizeof(PolyTerm);
+			usage.overhead += allocation_overhead(node, sizeof(PolyTerm));
+		}
+	}
+	if (const PreparedEvaluator *cached = evaluator.load(std::memory_order_acquire)) {
+		usage.bytes += cached->memoryBytes();
+	}
+	return usage;
+}
+
+Polynomial Polynomial::compacted() const {
+	CALC_TRACE_SCOPE("compacted");
+	Polynomial result;
+	const std::size_t count = count_terms(head);
+	if (count == 0) {
+		return result;
+	}
+	result.block = new_block(count);
+	std::size_t i = 0;
+	for (const PolyTerm *node = head; node; node = node->next, ++i) {
+		result.block[i] = {node->coefficient, node->exponent, i + 1 < count ? &result.block[i + 1] : nullptr};
+	}
+	result.head = result.block;
+	return result;
+}
+
+Polynomial createPoly(std::istream &is) {
 	Polynomial p;
-	int n;
-	std::cin >> n;
-	while (n--) {
+	int n = 0;
+	is >> n;
+	// stop at the first bad read so a short or empty stream cannot spin
+	while (n-- > 0) {
 		double coeff;
 		int exp;
-		std::cin >> coeff >> exp;
+		if (!(is >> coeff >> exp)) {
+			break;
+		}
 		p.addTerm(coeff, exp);
 	}
 	return p;
@@ -0,0 +1,161 @@
+#include "polynomial.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+
+namespace {
+
+// zeros a segment may take in to reach the next term; beyond that the term
+// starts a segment of its own
+constexpr long long MAX_GAP = 8;
+// leaves of four coefficients reduced together on the stack; longer
+// segments are joined in blocks of this many leaves by Horner in x^(4 GROUP)
+constexpr std::size_t GROUP = 64;
+
+std::uint32_t round_up(std::uint32_t length) {
+	return length == 1 ? 1 : (length + 3) & ~std::uint32_t{3};
+}
+
+// c[0] + c[1] x + ... + c[n - 1] x^(n - 1) for n a multiple of 4: leaves
+// c[i] + c[i+1] x + (c[i+2] + c[i+3] x) x^2, then neighbours joined pairwise
+// with x^4, x^8, ... The leaves are independent and every level halves
+// their number, so the chain is O(log n) deep
+double estrin(const double *c, std::size_t n, double x, double x2, double x4) {
+	const std::size_t block = 4 * GROUP;
+	const std::size_t blocks = (n + block - 1) / block;
+	double step = 0.0; // x^block, only needed with several blocks
+	if (blocks > 1) {
+		step = x4;
+		for (std::size_t k = 4; k < block; k <<= 1) {
+			step *= step;
+		}
+	}
+	double result = 0.0;
+	for (std::size_t b = blocks; b-- > 0;) {
+		const std::size_t begin = b * block;
+		const std::size_t end = std::min(n, begin + block);
+		double leaves[GROUP];
+		std::size_t count = 0;
+		for (std::size_t i = begin; i < end; i += 4) {
+			leaves[count++] = (c[i] + c[i + 1] * x) + (c[i + 2] + c[i + 3] * x) * x2;
+		}
+		for (double p = x4; count > 1; p *= p) {
+			const std::size_t half = count / 2;
+			for (std::size_t i = 0; i < half; ++i) {
+				leaves[i] = leaves[2 * i] + leaves[2 * i + 1] * p;
+			}
+			if (count & 1) {
+				leaves[half] = leaves[count - 1];
+			}
+			count = half + (count & 1);
+		}
+		result = b + 1 == blocks ? leaves[0] : result * step + leaves[0];
+	}
+	return result;
+}
+
+} // namespace
+
+PreparedEvaluator::PreparedEvaluator(const Polynomial &poly) {
+	CALC_TRACE_SCOPE("prepare_evaluator");
+	std::vector<const PolyTerm *> terms;
+	for (const PolyTerm *node = poly.terms(); node; node = node->next) {
+		terms.push_back(node);
+	}
+	// lowest exponent first; a segment grows while the gaps stay small
+	std::uint32_t magnitude = 0;
+	for (std::size_t i = terms.size(); i-- > 0;) {
+		const PolyTerm *term = terms[i];
+		if (!segments.empty()) {
+			Segment &last = segments.back();
+			long long end = static_cast<long long>(last.start) + last.length; // one past the last exponent
+			long long gap = term->exponent - end;
+			if (gap <= MAX_GAP) {
+				coefficients.insert(coefficients.end(), static_cast<std::size_t>(gap), 0.0);
+				coefficients.push_back(term->coefficient);
+				last.length += static_cast<std::uint32_t>(gap) + 1;
+				continue;
+			}
+			std::uint32_t padded = round_up(last.length);
+			coefficients.insert(coefficients.end(), padded - last.length, 0.0);
+			last.length = padded;
+		}
+		segments.push_back({term->exponent, 1});
+		coefficients.push_back(term->coefficient);
+		magnitude = std::max(magnitude, static_cast<std::uint32_t>(std::abs(static_cast<long long>(term->exponent))));
+		negative = negative || term->exponent < 0;
+	}
+	if (!segments.empty()) {
+		Segment &last = segments.back();
+		std::uint32_t padded = round_up(last.length);
+		coefficients.insert(coefficients.end(), padded - last.length, 0.0);
+		last.length = padded;
+	}
+	squares = std::bit_width(magnitude);
+}
+
+double PreparedEvaluator::operator()(double x) const {
+	const double x2 = x * x;
+	const double x4 = x2 * x2;
+	if (segments.size() == 1 && segments[0].start == 0) {
+		// the dense case, no powers to look up
+		return segments[0].length == 1 ? coefficients[0] : estrin(coefficients.data(), segments[0].length, x, x2, x4);
+	}
+	// x^(d 4^k) for the base-4 digits d of the starts, and (1/x)^(d 4^k)
+	// for negative starts: one chain of squarings shared by every segment.
+	// A digit indexes its row instead of branching (random exponents would
+	// mispredict), and even and odd digits go to two chains of products
+	const int levels = ((squares + 1) / 2 + 1) & ~1;
+	double up[16][4];
+	double down[16][4];
+	auto fill = [levels](double (*table)[4], double base) {
+		for (int k = 0; k < levels; ++k) {
+			table[k][0] = 1.0;
+			table[k][1] = base;
+			table[k][2] = base * base;
+			table[k][3] = table[k][2] * base;
+			base = table[k][2] * table[k][2];
+		}
+	};
+	fill(up, x);
+	if (negative) {
+		fill(down, 1.0 / x);
+	}
+	double sums[4] = {0.0, 0.0, 0.0, 0.0};
+	const double *c = coefficients.data();
+	for (std::size_t s = 0; s < segments.size(); ++s) {
+		const Segment &segment = segments[s];
+		double value = segment.length == 1 ? c[0] : estrin(c, segment.length, x, x2, x4);
+		c += segment.length;
+		const double (*table)[4] = segment.start < 0 ? down : up;
+		std::uint32_t e = static_cast<std::uint32_t>(std::abs(static_cast<long long>(segment.start)));
+		double odd = 1.0;
+		for (int k = 0; e; e >>= 4, k += 2) {
+			value *= table[k][e & 3];
+			odd *= table[k + 1][(e >> 2) & 3];
+		}
+		value *= odd;
+		sums[s & 3] += value;
+	}
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+std::size_t PreparedEvaluator::segmentCount() const {
+	return segments.size();
+}
+
+const PreparedEvaluator &Polynomial::prepared() const {
+	if (const PreparedEvaluator *cached = evaluator.load(std::memory_order_acquire)) {
+		return *cached;
+	}
+	// racing threads may each build one; the first to publish wins
+	auto *built = new PreparedEvaluator(*this);
+	const PreparedEvaluator *expected = nullptr;
+	if (!evaluator.compare_exchange_strong(expected, built, std::memory_order_acq_rel, std::memory_order_acquire)) {
+		delete built;
+		return *expected;
+	}
+	return *built;
+}
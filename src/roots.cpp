@@ -0,0 +1,321 @@
+#include "polynomial.hpp"
+#include "cancel.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+
+namespace {
+
+using Complex = std::complex<double>;
+
+// the dense coefficient array grows with the exponent span, not the term count
+constexpr std::size_t MAX_DEGREE = std::size_t{1} << 20;
+constexpr int MAX_ITERATIONS = 500;
+// roots per task; each root costs O(degree) per iteration
+constexpr std::size_t ROOT_GRAIN = 64;
+constexpr std::size_t EVAL_LANES = 8;
+
+struct Evaluation {
+	Complex newton;      // P(z) / P'(z)
+	double log_value;    // log |P(z)|
+	double residual;     // |P(z)| / sum |a_k||z|^k
+};
+
+// evaluates P and P' at up to EVAL_LANES points that share a direction.
+// Outside the unit disc the reversed polynomial is evaluated at 1/z instead,
+// so z^n never overflows:
+//   P(z) = z^n R(1/z),  P'(z) = z^(n-1) (n R(y) - y R'(y))
+// Horner's rule is one long dependency chain per point; running the points
+// interleaved, real and imaginary parts in separate arrays, keeps the
+// floating-point units busy
+void evaluate_lanes(const std::vector<double> &a, const Complex *z, const std::size_t *index, std::size_t lanes,
+                    bool reversed, Evaluation *out) {
+	const std::size_t n = a.size() - 1;
+	double xr[EVAL_LANES] = {}, xi[EVAL_LANES] = {}, r[EVAL_LANES] = {};
+	for (std::size_t l = 0; l < lanes; ++l) {
+		Complex x = reversed ? 1.0 / z[index[l]] : z[index[l]];
+		xr[l] = x.real();
+		xi[l] = x.imag();
+		r[l] = std::abs(x);
+	}
+	double pr[EVAL_LANES] = {}, pi[EVAL_LANES] = {}, dr[EVAL_LANES] = {}, di[EVAL_LANES] = {}, scale[EVAL_LANES] = {};
+	for (std::size_t t = 0; t <= n; ++t) {
+		const double c = reversed ? a[t] : a[n - t];
+		const double magnitude = std::abs(c);
+		for (std::size_t l = 0; l < EVAL_LANES; ++l) {
+			double ndr = dr[l] * xr[l] - di[l] * xi[l] + pr[l];
+			double ndi = dr[l] * xi[l] + di[l] * xr[l] + pi[l];
+			double npr = pr[l] * xr[l] - pi[l] * xi[l] + c;
+			pi[l] = pr[l] * xi[l] + pi[l] * xr[l];
+			pr[l] = npr;
+			dr[l] = ndr;
+			di[l] = ndi;
+			scale[l] = scale[l] * r[l] + magnitude;
+		}
+	}
+	for (std::size_t l = 0; l < lanes; ++l) {
+		Complex x = z[index[l]];
+		Complex p(pr[l], pi[l]), dp(dr[l], di[l]);
+		Evaluation &result = out[index[l]];
+		if (reversed) {
+			Complex y(xr[l], xi[l]);
+			result.newton = x * p / (static_cast<double>(n) * p - y * dp);
+			result.log_value = static_cast<double>(n) * std::log(std::abs(x)) + std::log(std::abs(p));
+		} else {
+			result.newton = p / dp;
+			result.log_value = std::log(std::abs(p));
+		}
+		result.residual = scale[l] > 0.0 ? std::abs(p) / scale[l] : 0.0;
+	}
+}
+
+// evaluates P and P' at count <= ROOT_GRAIN points
+void evaluate(const std::vector<double> &a, const Complex *z, std::size_t count, Evaluation *out) {
+	std::size_t order[ROOT_GRAIN];
+	std::size_t inside = 0, outside = count;
+	for (std::size_t k = 0; k < count; ++k) {
+		if (std::abs(z[k]) <= 1.0) {
+			order[inside++] = k;
+		} else {
+			order[--outside] = k;
+		}
+	}
+	for (std::size_t base = 0; base < inside; base += EVAL_LANES) {
+		evaluate_lanes(a, z, order + base, std::min(EVAL_LANES, inside - base), false, out);
+	}
+	for (std::size_t base = inside; base < count; base += EVAL_LANES) {
+		evaluate_lanes(a, z, order + base, std::min(EVAL_LANES, count - base), true, out);
+	}
+}
+
+// initial estimates on circles whose radii come from the upper convex hull
+// of (k, log|a_k|), the Newton polygon; a hull edge from i to j yields j - i
+// roots of modulus (|a_i| / |a_j|)^(1 / (j - i))
+std::vector<Complex> initial_estimates(const std::vector<double> &a) {
+	const std::size_t n = a.size() - 1;
+	std::vector<std::size_t> hull;
+	auto height = [&](std::size_t k) {
+		return a[k] == 0.0 ? -std::numeric_limits<double>::infinity() : std::log(std::abs(a[k]));
+	};
+	for (std::size_t k = 0; k <= n; ++k) {
+		if (a[k] == 0.0) {
+			continue;
+		}
+		while (hull.size() >= 2) {
+			std::size_t i = hull[hull.size() - 2], j = hull.back();
+			// drop j when it lies on or below the segment from i to k
+			double cross = (height(j) - height(i)) * static_cast<double>(k - i)
+			             - (height(k) - height(i)) * static_cast<double>(j - i);
+			if (cross > 0.0) {
+				break;
+			}
+			hull.pop_back();
+		}
+		hull.push_back(k);
+	}
+
+	std::vector<Complex> z;
+	z.reserve(n);
+	// the offset keeps the circles from aligning with the real axis, where
+	// real polynomials would keep the iterates stuck on conjugate symmetry
+	constexpr double offset = 0.7;
+	const double two_pi = 2.0 * std::numbers::pi;
+	for (std::size_t e = 0; e + 1 < hull.size(); ++e) {
+		std::size_t i = hull[e], j = hull[e + 1];
+		std::size_t count = j - i;
+		double radius = std::exp((height(i) - height(j)) / static_cast<double>(count));
+		for (std::size_t m = 0; m < count; ++m) {
+			double angle = two_pi * (static_cast<double>(m) / static_cast<double>(count) + static_cast<double>(e) / static_cast<double>(n)) + offset;
+			z.push_back(std::polar(radius, angle));
+		}
+	}
+	return z;
+}
+
+// runs body(begin, end) over blocks of at most ROOT_GRAIN roots, on the
+// global pool when there is more than one block
+template <typename F>
+void for_each_block(std::size_t count, F &&body) {
+	if (count <= ROOT_GRAIN) {
+		body(0, count);
+		return;
+	}
+	TaskGroup group(ThreadPool::global());
+	for (std::size_t begin = 0; begin < count; begin += ROOT_GRAIN) {
+		group.run([&body, begin, end = std::min(count, begin + ROOT_GRAIN)] { body(begin, end); });
+	}
+	group.wait();
+}
+
+// sum over j in [begin, end) of 1 / (x - z_j), on split real/imaginary
+// arrays. Independent partial sums let the compiler pair lanes into SIMD
+// operations, which it may not do for a single floating-point reduction
+Complex repulsion(const double *re, const double *im, std::size_t begin, std::size_t end, double xr, double xi) {
+	constexpr std::size_t LANES = 4;
+	double sr[LANES] = {}, si[LANES] = {};
+	std::size_t j = begin;
+	for (; j + LANES <= end; j += LANES) {
+		for (std::size_t l = 0; l < LANES; ++l) {
+			double dr = xr - re[j + l], di = xi - im[j + l];
+			double inv = 1.0 / (dr * dr + di * di);
+			sr[l] += dr * inv;
+			si[l] -= di * inv;
+		}
+	}
+	for (; j < end; ++j) {
+		double dr = xr - re[j], di = xi - im[j];
+		double inv = 1.0 / (dr * dr + di * di);
+		sr[0] += dr * inv;
+		si[0] -= di * inv;
+	}
+	return {(sr[0] + sr[1]) + (sr[2] + sr[3]), (si[0] + si[1]) + (si[2] + si[3])};
+}
+
+// log prod_{j in [begin, end)} |x - z_j|^2; the running product is
+// renormalized instead of taking a logarithm per factor
+double log_distance_product(const double *re, const double *im, std::size_t begin, std::size_t end, double xr, double xi) {
+	double product = 1.0;
+	long long exponent = 0;
+	for (std::size_t j = begin; j < end; ++j) {
+		double dr = xr - re[j], di = xi - im[j];
+		product *= dr * dr + di * di;
+		if (!(product > 0x1p-500 && product < 0x1p500)) {
+			int e;
+			product = std::frexp(product, &e);
+			exponent += e;
+		}
+	}
+	return std::log(product) + static_cast<double>(exponent) * std::numbers::ln2;
+}
+
+// Aberth-Ehrlich iteration with Jacobi-style updates: every step reads the
+// previous estimates only, so roots are updated independently in parallel.
+// a root stops moving once its backward error reaches the rounding level of
+// Horner's rule
+std::vector<PolyRoot> aberth(const std::vector<double> &a) {
+	const std::size_t n = a.size() - 1;
+	std::vector<Complex> z = initial_estimates(a);
+	std::vector<double> re(n), im(n);
+	std::vector<char> converged(n, 0);
+	const double tolerance = 4.0 * static_cast<double>(n + 1) * std::numeric_limits<double>::epsilon();
+
+	for (int iteration = 0; iteration < MAX_ITERATIONS; ++iteration) {
+		CALC_TRACE_SCOPE("aberth_step");
+		for (std::size_t i = 0; i < n; ++i) {
+			re[i] = z[i].real();
+			im[i] = z[i].imag();
+		}
+		std::vector<std::size_t> active;
+		for (std::size_t i = 0; i < n; ++i) {
+			if (!converged[i]) {
+				active.push_back(i);
+			}
+		}
+		if (active.empty()) {
+			break;
+		}
+		cancel::progress("poly roots", n - active.size(), n);
+		for_each_block(active.size(), [&](std::size_t begin, std::size_t end) {
+			cancel::checkpoint();
+			Complex points[ROOT_GRAIN];
+			Evaluation values[ROOT_GRAIN];
+			for (std::size_t k = begin; k < end; ++k) {
+				points[k - begin] = z[active[k]];
+			}
+			evaluate(a, points, end - begin, values);
+			for (std::size_t k = begin; k < end; ++k) {
+				std::size_t i = active[k];
+				Complex x = points[k - begin];
+				const Evaluation &e = values[k - begin];
+				if (e.residual <= tolerance || !std::isfinite(std::abs(e.newton))) {
+					converged[i] = 1;
+					continue;
+				}
+				Complex w = e.newton;
+				Complex sum = repulsion(re.data(), im.data(), 0, i, x.real(), x.imag())
+				            + repulsion(re.data(), im.data(), i + 1, n, x.real(), x.imag());
+				Complex step = w / (1.0 - w * sum);
+				z[i] = x - step;
+				if (std::abs(step) <= std::numeric_limits<double>::epsilon() * std::abs(z[i])) {
+					converged[i] = 1;
+				}
+			}
+		});
+	}
+
+	// inclusion radii: the disc |x - z_i| <= n |W_i| with the Weierstrass
+	// correction W_i = P(z_i) / (a_n prod_{j != i} (z_i - z_j)) holds a root.
+	// products are summed in the log domain, they overflow for large n
+	for (std::size_t i = 0; i < n; ++i) {
+		re[i] = z[i].real();
+		im[i] = z[i].imag();
+	}
+	std::vector<PolyRoot> roots(n);
+	const double log_lead = std::log(std::abs(a[n]));
+	for_each_block(n, [&](std::size_t begin, std::size_t end) {
+		cancel::checkpoint();
+		Evaluation values[ROOT_GRAIN];
+		evaluate(a, z.data() + begin, end - begin, values);
+		for (std::size_t i = begin; i < end; ++i) {
+			const Evaluation &e = values[i - begin];
+			double log_product = 0.5 * (log_distance_product(re.data(), im.data(), 0, i, re[i], im[i])
+			                          + log_distance_product(re.data(), im.data(), i + 1, n, re[i], im[i]));
+			double log_bound = std::log(static_cast<double>(n)) + e.log_value - log_lead - log_product;
+			roots[i] = {z[i], e.residual, std::exp(log_bound)};
+		}
+	});
+	return roots;
+}
+
+} // namespace
+
+std::vector<PolyRoot> Polynomial::roots() const {
+	CALC_TRACE_SCOPE("roots");
+	if (!head) {
+		throw std::runtime_error("零多项式的根不是有限集");
+	}
+	// P(x) = x^low * Q(x) with Q(0) != 0
+	const long long high = head->exponent;
+	long long low = high;
+	for (const PolyTerm *node = head; node; node = node->next) {
+		low = node->exponent;
+	}
+	const auto degree = static_cast<std::size_t>(high - low);
+	if (degree > MAX_DEGREE) {
+		throw std::runtime_error(std::format("最高与最低次数相差 {}，超过求根上限 {}", degree, MAX_DEGREE));
+	}
+
+	// x = 0 is listed low times, so its multiplicity counts against the limit too
+	if (low > 0 && static_cast<std::size_t>(high) > MAX_DEGREE) {
+		throw std::runtime_error(std::format("共有 {} 个根（x = 0 占 {} 个），超过求根上限 {}", high, low, MAX_DEGREE));
+	}
+
+	std::vector<PolyRoot> result;
+	if (low > 0) {
+		result.assign(static_cast<std::size_t>(low), PolyRoot{0.0, 0.0, 0.0});
+	}
+	if (degree == 0) {
+		return result;
+	}
+	std::vector<double> q(degree + 1, 0.0);
+	for (const PolyTerm *node = head; node; node = node->next) {
+		q[static_cast<std::size_t>(node->exponent - low)] = node->coefficient;
+	}
+	std::vector<PolyRoot> found = degree == 1
+		? std::vector<PolyRoot>{{-q[0] / q[1], 0.0, 0.0}}
+		: aberth(q);
+	result.insert(result.end(), found.begin(), found.end());
+	std::sort(result.begin(), result.end(), [](const PolyRoot &x, const PolyRoot &y) {
+		if (x.value.real() != y.value.real()) {
+			return x.value.real() < y.value.real();
+		}
+		return x.value.imag() < y.value.imag();
+	});
+	return result;
+}
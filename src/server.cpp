@@ -0,0 +1,385 @@
+#include "server.hpp"
+#include "cli.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+int run_server(const std::string &, std::size_t) {
+    throw std::runtime_error("此平台不支持服务器模式");
+}
+
+void request_server_stop() {}
+
+#else
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0; // SIGPIPE is ignored in run_server instead
+#endif
+
+// requests longer than this are rejected and the connection is closed
+constexpr std::size_t MAX_LINE = std::size_t{256} << 20;
+// bytes read from one session per wakeup, so a client that keeps sending
+// cannot hold the event loop away from the others
+constexpr std::size_t MAX_READ = std::size_t{1} << 20;
+// queued requests per session; further lines wait in the input buffer and
+// the socket is not read until the queue has room again
+constexpr std::size_t MAX_PENDING = 1024;
+
+std::atomic<int> wake_fd{-1};
+std::atomic<bool> stop_requested{false};
+
+void wake_loop() {
+    int fd = wake_fd.load();
+    if (fd >= 0) {
+        char byte = 1;
+        [[maybe_unused]] auto ignored = ::write(fd, &byte, 1);
+    }
+}
+
+void set_nonblocking(int fd) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+struct Session {
+    int fd;
+    CLIContext context;      // touched only by the worker running this session,
+                             // except for the stores, which all sessions share
+    std::string input;       // touched only by the event loop
+    std::size_t complete = 0; // input[0, complete) holds whole lines not yet queued
+
+    std::mutex mutex;        // guards everything below
+    std::deque<std::string> pending;
+    std::string output;
+    bool busy = false;       // a worker is draining `pending`
+    bool closing = false;    // exit was requested or the line limit exceeded
+    bool peer_closed = false; // end of input: answer what was sent, then close
+    bool broken = false;     // the connection failed, nothing can be delivered
+
+    Session(int descriptor, const CLIContext &shared) : fd(descriptor), context(shared) {}
+};
+
+void append_response(Session &session, bool ok, const std::string &body) {
+    session.output += ok ? "OK " : "ERR ";
+    session.output += std::to_string(body.size());
+    session.output += '\n';
+    session.output += body;
+}
+
+void drain_session(const std::shared_ptr<Session> &session) {
+    // runs the queued commands of one session in order, on a worker thread
+    while (true) {
+        std::string line;
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            if (session->pending.empty() || session->closing) {
+                session->busy = false;
+                break;
+            }
+            line = std::move(session->pending.front());
+            session->pending.pop_front();
+        }
+        std::istringstream in;
+        std::ostringstream out;
+        bool ok = true;
+        bool exit = false;
+        try {
+            exit = execute_command(session->context, line, in, out) == CommandStatus::Exit;
+        } catch (const std::exception &e) {
+            ok = false;
+            out.str(std::string(e.what()) + '\n');
+        }
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            append_response(*session, ok, out.str());
+            if (exit) {
+                session->closing = true;
+                session->pending.clear();
+            }
+        }
+        wake_loop();
+    }
+    wake_loop();
+}
+
+class Server {
+public:
+    Server(const std::string &path, std::size_t workers) : path_(path), pool_(workers) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("套接字路径过长");
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        int pipe_fds[2];
+        if (::pipe(pipe_fds) != 0) {
+            throw std::runtime_error("无法创建唤醒管道");
+        }
+        wake_read_ = pipe_fds[0];
+        wake_write_ = pipe_fds[1];
+        set_nonblocking(wake_read_);
+        set_nonblocking(wake_write_);
+
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd_ < 0) {
+            throw std::runtime_error("无法创建套接字");
+        }
+        ::unlink(path.c_str());
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listen_fd_, SOMAXCONN) != 0) {
+            ::close(listen_fd_);
+            throw std::runtime_error(std::format("无法监听 {}：{}", path, std::strerror(errno)));
+        }
+        set_nonblocking(listen_fd_);
+        wake_fd = wake_write_;
+    }
+
+    ~Server() {
+        wake_fd = -1;
+        for (auto &entry : sessions_) {
+            ::close(entry.first);
+        }
+        ::close(listen_fd_);
+        ::unlink(path_.c_str());
+        ::close(wake_read_);
+        ::close(wake_write_);
+    }
+
+    void run() {
+        std::vector<pollfd> fds;
+        while (!stop_requested) {
+            fds.clear();
+            fds.push_back({listen_fd_, POLLIN, 0});
+            fds.push_back({wake_read_, POLLIN, 0});
+            for (auto &[fd, session] : sessions_) {
+                std::lock_guard<std::mutex> lock(session->mutex);
+                // after end of input only writes are waited for; a socket at
+                // EOF is always readable and would keep poll from blocking
+                // nor is it read while whole lines wait for room in the queue
+                short events = session->peer_closed || session->complete > 0 ? 0 : POLLIN;
+                if (!session->output.empty()) {
+                    events |= POLLOUT;
+                }
+                if (events != 0) {
+                    fds.push_back({fd, events, 0});
+                }
+            }
+            if (::poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("poll 调用失败");
+            }
+            if (fds[1].revents & POLLIN) {
+                char drain[256];
+                while (::read(wake_read_, drain, sizeof(drain)) > 0) {
+                }
+            }
+            if (fds[0].revents & POLLIN) {
+                accept_clients();
+            }
+            for (std::size_t i = 2; i < fds.size(); ++i) {
+                auto it = sessions_.find(fds[i].fd);
+                if (it == sessions_.end()) {
+                    continue;
+                }
+                std::shared_ptr<Session> session = it->second;
+                if (fds[i].revents & (POLLIN | POLLERR) && (fds[i].events & POLLIN)) {
+                    read_requests(session);
+                }
+                if (fds[i].revents & (POLLOUT | POLLHUP | POLLERR)) {
+                    // a failed send marks the session broken
+                    write_responses(*session);
+                }
+            }
+            for (auto &[fd, session] : sessions_) {
+                if (session->complete > 0) {
+                    queue_requests(session);
+                }
+            }
+            reap_sessions();
+        }
+    }
+
+private:
+    std::string path_;
+    ThreadPool pool_;
+    CLIContext shared_; // every session context points at these stores
+    int listen_fd_ = -1;
+    int wake_read_ = -1;
+    int wake_write_ = -1;
+    std::unordered_map<int, std::shared_ptr<Session>> sessions_;
+
+    void accept_clients() {
+        while (true) {
+            int fd = ::accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) {
+                return;
+            }
+            set_nonblocking(fd);
+            sessions_.emplace(fd, std::make_shared<Session>(fd, shared_));
+        }
+    }
+
+    void read_requests(const std::shared_ptr<Session> &session) {
+        char chunk[65536];
+        std::size_t total = 0;
+        while (total < MAX_READ) {
+            ssize_t received = ::recv(session->fd, chunk, sizeof(chunk), 0);
+            if (received > 0) {
+                // only the new bytes are searched for the end of a line
+                for (std::size_t i = static_cast<std::size_t>(received); i-- > 0;) {
+                    if (chunk[i] == '\n') {
+                        session->complete = session->input.size() + i + 1;
+                        break;
+                    }
+                }
+                session->input.append(chunk, static_cast<std::size_t>(received));
+                total += static_cast<std::size_t>(received);
+                if (session->input.size() - session->complete > MAX_LINE) {
+                    std::lock_guard<std::mutex> lock(session->mutex);
+                    append_response(*session, false, "请求行过长");
+                    session->closing = true;
+                    session->input.clear();
+                    session->complete = 0;
+                    return;
+                }
+                continue;
+            }
+            if (received == 0) {
+                // a half-close still expects the answers to what was sent;
+                // an unterminated last line counts as a request
+                std::lock_guard<std::mutex> lock(session->mutex);
+                session->peer_closed = true;
+                if (!session->input.empty() && session->input.back() != '\n') {
+                    session->input += '\n';
+                }
+                session->complete = session->input.size();
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::lock_guard<std::mutex> lock(session->mutex);
+                session->broken = true;
+            }
+            break;
+        }
+        queue_requests(session);
+    }
+
+    // moves whole lines from the input to the queue, as many as it has room for
+    void queue_requests(const std::shared_ptr<Session> &session) {
+        std::size_t room;
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            if (session->closing) {
+                session->input.clear();
+                session->complete = 0;
+                return;
+            }
+            // workers only shrink the queue, so the room can only grow meanwhile
+            room = MAX_PENDING - std::min(MAX_PENDING, session->pending.size());
+        }
+
+        std::vector<std::string> lines;
+        std::size_t begin = 0;
+        while (begin < session->complete && lines.size() < room) {
+            std::size_t newline = session->input.find('\n', begin);
+            std::string line = session->input.substr(begin, newline - begin);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            lines.push_back(std::move(line));
+            begin = newline + 1;
+        }
+        session->input.erase(0, begin);
+        session->complete -= begin;
+
+        std::lock_guard<std::mutex> lock(session->mutex);
+        if (session->closing) {
+            return;
+        }
+        for (auto &line : lines) {
+            session->pending.push_back(std::move(line));
+        }
+        if (!session->pending.empty() && !session->busy) {
+            session->busy = true;
+            pool_.submit([session] { drain_session(session); });
+        }
+    }
+
+    void write_responses(Session &session) {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        while (!session.output.empty()) {
+            ssize_t sent = ::send(session.fd, session.output.data(), session.output.size(), SEND_FLAGS);
+            if (sent <= 0) {
+                if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    session.broken = true;
+                    session.output.clear();
+                }
+                return;
+            }
+            session.output.erase(0, static_cast<std::size_t>(sent));
+        }
+    }
+
+    void reap_sessions() {
+        for (auto it = sessions_.begin(); it != sessions_.end();) {
+            Session &session = *it->second;
+            bool done;
+            {
+                std::lock_guard<std::mutex> lock(session.mutex);
+                bool answered = session.output.empty() && (session.closing || session.pending.empty());
+                answered = answered && (session.closing || session.complete == 0);
+                done = !session.busy && (session.broken || ((session.peer_closed || session.closing) && answered));
+            }
+            if (done) {
+                ::close(it->first);
+                it = sessions_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+} // namespace
+
+int run_server(const std::string &socket_path, std::size_t workers) {
+    std::signal(SIGPIPE, SIG_IGN);
+    stop_requested = false;
+    Server server(socket_path, workers);
+    std::cerr << std::format("正在监听 {}\n", socket_path);
+    server.run();
+    return 0;
+}
+
+void request_server_stop() {
+    stop_requested = true;
+    wake_loop();
+}
+
+#endif
@@ -0,0 +1,361 @@
+#include "snapshot.hpp"
+#include "trace.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <iterator>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr char MAGIC[8] = {'C', 'A', 'L', 'C', 'P', 'O', 'L', 'Y'};
+// 2 added polynomials on disk, 3 multivariate and compact ones; all are read
+constexpr std::uint32_t VERSION = 3;
+constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t count;
+    std::uint64_t file_size;
+};
+
+struct IndexEntry {
+    std::uint64_t name_offset;
+    std::uint32_t name_length;
+    std::uint32_t kind; // 0 in version 1
+    std::uint64_t term_count;
+    std::uint64_t terms_offset; // coefficients, followed by the exponents
+};
+
+static_assert(sizeof(Header) == 32 && sizeof(IndexEntry) == 32, "snapshot layout must not depend on padding");
+static_assert(sizeof(int) == sizeof(std::int32_t), "PolyTerm exponents are stored as int32");
+static_assert(sizeof(MultiTerm) == 16 && sizeof(CompactPolynomial::Term) == 16, "term records must not depend on padding");
+
+enum Kind : std::uint32_t {
+    LIST = 0,    // coefficients (double), then exponents (int32)
+    DISK = 1,    // DiskPolynomial::Term records (double, int64)
+    MULTI = 2,   // the variable letters (char[8], zero-padded), then MultiTerm records
+    COMPACT = 3, // CompactPolynomial::Term records (double, int64), decoded
+};
+
+// buffer for copying term records of polynomials on disk
+constexpr std::size_t COPY_BUFFER = std::size_t{1} << 20;
+
+std::uint64_t align8(std::uint64_t offset) {
+    return (offset + 7) & ~std::uint64_t{7};
+}
+
+class MappedFile {
+    // read-only view of a whole file, memory-mapped where the platform allows
+public:
+    explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error(std::format("无法打开快照 {}", path));
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(std::format("无法打开快照 {}", path));
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error(std::format("无法读取快照 {} 的大小", path));
+        }
+        size_ = static_cast<std::size_t>(info.st_size);
+        if (size_ > 0) {
+            void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error(std::format("无法映射快照 {}", path));
+            }
+            ::madvise(mapping, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char *>(mapping);
+        }
+        ::close(fd);
+#endif
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() {
+#ifndef _WIN32
+        if (data_) {
+            ::munmap(const_cast<char *>(data_), size_);
+        }
+#endif
+    }
+
+    const char *data() const {
+        return data_;
+    }
+    std::size_t size() const {
+        return size_;
+    }
+
+private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    std::vector<char> buffer_;
+#endif
+};
+
+void check_range(std::uint64_t offset, std::uint64_t length, std::size_t size) {
+    if (offset > size || length > size - offset) {
+        throw std::runtime_error("快照不完整或已损坏");
+    }
+}
+
+// count records of record_size bytes at offset; checked by division, the
+// product of untrusted values may wrap around
+void check_records(std::uint64_t offset, std::uint64_t count, std::uint64_t record_size, std::size_t size) {
+    if (offset > size || count > (size - offset) / record_size) {
+        throw std::runtime_error("快照不完整或已损坏");
+    }
+}
+
+} // namespace
+
+void save_snapshot(const std::string &path, const std::vector<PolyEntry> &polynomials,
+                   const std::vector<MultiPolyStore::Entry> &multipolys,
+                   const std::vector<CompactPolyStore::Entry> &compacts,
+                   const std::vector<DiskPolyStore::Entry> &disk_polynomials) {
+    CALC_TRACE_SCOPE("save_snapshot");
+    // lay out the file first, then stream it out in one pass
+    std::vector<IndexEntry> index;
+    std::uint64_t offset = sizeof(Header) +
+                           (polynomials.size() + multipolys.size() + compacts.size() + disk_polynomials.size()) * sizeof(IndexEntry);
+    auto place_terms = [&](Kind kind, std::uint64_t term_count, std::uint64_t bytes) {
+        IndexEntry entry{};
+        entry.kind = kind;
+        entry.term_count = term_count;
+        entry.terms_offset = offset;
+        offset = align8(offset + bytes);
+        index.push_back(entry);
+    };
+    for (const auto &[name, poly] : polynomials) {
+        place_terms(LIST, poly->termCount(), poly->termCount() * (sizeof(double) + sizeof(std::int32_t)));
+    }
+    for (const auto &[name, poly] : multipolys) {
+        place_terms(MULTI, poly->termCount(), MultiPolynomial::MAX_VARIABLES + poly->termCount() * sizeof(MultiTerm));
+    }
+    for (const auto &[name, poly] : compacts) {
+        place_terms(COMPACT, poly->termCount(), poly->termCount() * sizeof(CompactPolynomial::Term));
+    }
+    for (const auto &[name, poly] : disk_polynomials) {
+        place_terms(DISK, poly->termCount(), poly->termCount() * sizeof(DiskPolynomial::Term));
+    }
+    std::size_t i = 0;
+    auto place_name = [&](const std::string &name) {
+        index[i].name_offset = offset;
+        index[i].name_length = static_cast<std::uint32_t>(name.size());
+        offset += name.size();
+        ++i;
+    };
+    for (const auto &entry : polynomials) {
+        place_name(entry.first);
+    }
+    for (const auto &entry : multipolys) {
+        place_name(entry.first);
+    }
+    for (const auto &entry : compacts) {
+        place_name(entry.first);
+    }
+    for (const auto &entry : disk_polynomials) {
+        place_name(entry.first);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.count = index.size();
+    header.file_size = offset;
+
+    // write to a temporary file so a failed save never clobbers the old snapshot
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error(std::format("无法创建快照 {}", temporary));
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(IndexEntry)));
+
+        const char padding[8] = {};
+        auto pad = [&](std::uint64_t written) {
+            out.write(padding, static_cast<std::streamsize>(align8(written) - written));
+        };
+        std::vector<double> coefficients;
+        std::vector<std::int32_t> exponents;
+        for (const auto &[name, poly] : polynomials) {
+            coefficients.clear();
+            exponents.clear();
+            for (const PolyTerm *node = poly->terms(); node; node = node->next) {
+                coefficients.push_back(node->coefficient);
+                exponents.push_back(node->exponent);
+            }
+            out.write(reinterpret_cast<const char *>(coefficients.data()), static_cast<std::streamsize>(coefficients.size() * sizeof(double)));
+            out.write(reinterpret_cast<const char *>(exponents.data()), static_cast<std::streamsize>(exponents.size() * sizeof(std::int32_t)));
+            pad(coefficients.size() * (sizeof(double) + sizeof(std::int32_t)));
+        }
+        for (const auto &[name, poly] : multipolys) {
+            char variables[MultiPolynomial::MAX_VARIABLES] = {};
+            std::memcpy(variables, poly->variables().data(), poly->variables().size());
+            out.write(variables, sizeof(variables));
+            const std::vector<MultiTerm> &terms = poly->terms();
+            out.write(reinterpret_cast<const char *>(terms.data()), static_cast<std::streamsize>(terms.size() * sizeof(MultiTerm)));
+        }
+        std::vector<DiskPolynomial::Term> records;
+        auto flush_records = [&] {
+            out.write(reinterpret_cast<const char *>(records.data()),
+                      static_cast<std::streamsize>(records.size() * sizeof(DiskPolynomial::Term)));
+            records.clear();
+        };
+        for (const auto &[name, poly] : compacts) {
+            for (CompactPolynomial::Cursor cursor = poly->begin(); !cursor.done(); cursor.next()) {
+                records.push_back(cursor.term());
+                if (records.size() == COPY_BUFFER / sizeof(DiskPolynomial::Term)) {
+                    flush_records();
+                }
+            }
+            flush_records();
+        }
+        for (const auto &[name, poly] : disk_polynomials) {
+            DiskPolynomial::Reader reader(*poly, COPY_BUFFER);
+            while (!reader.done()) {
+                for (; !reader.done() && records.size() < COPY_BUFFER / sizeof(DiskPolynomial::Term); reader.next()) {
+                    records.push_back(reader.term());
+                }
+                flush_records();
+            }
+        }
+        for (const auto &entry : polynomials) {
+            out.write(entry.first.data(), static_cast<std::streamsize>(entry.first.size()));
+        }
+        for (const auto &entry : multipolys) {
+            out.write(entry.first.data(), static_cast<std::streamsize>(entry.first.size()));
+        }
+        for (const auto &entry : compacts) {
+            out.write(entry.first.data(), static_cast<std::streamsize>(entry.first.size()));
+        }
+        for (const auto &entry : disk_polynomials) {
+            out.write(entry.first.data(), static_cast<std::streamsize>(entry.first.size()));
+        }
+        if (!out.flush()) {
+            throw std::runtime_error(std::format("写入快照 {} 失败", temporary));
+        }
+    }
+    // replaces the old snapshot in one step, a crash leaves one of the two
+#ifdef _WIN32
+    if (!MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+#endif
+        std::remove(temporary.c_str());
+        throw std::runtime_error(std::format("无法将快照重命名为 {}", path));
+    }
+}
+
+std::size_t load_snapshot(const std::string &path, PolyStore &store, MultiPolyStore &multi_store,
+                          CompactPolyStore &compact_store, DiskPolyStore &disk_store, const DiskLimits &limits) {
+    CALC_TRACE_SCOPE("load_snapshot");
+    MappedFile file(path);
+    const char *data = file.data();
+    std::size_t size = file.size();
+
+    check_range(0, sizeof(Header), size);
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(std::format("{} 不是多项式快照", path));
+    }
+    if (header.byte_order != BYTE_ORDER_MARK) {
+        throw std::runtime_error("快照来自字节序不同的机器");
+    }
+    if (header.version == 0 || header.version > VERSION) {
+        throw std::runtime_error(std::format("不支持的快照版本 {}", header.version));
+    }
+    if (header.file_size != size) {
+        throw std::runtime_error("快照不完整或已损坏");
+    }
+    check_records(sizeof(Header), header.count, sizeof(IndexEntry), size);
+
+    // validate and build everything before touching the stores
+    std::vector<std::pair<std::string, Polynomial>> loaded;
+    std::vector<std::pair<std::string, MultiPolynomial>> loaded_multi;
+    std::vector<std::pair<std::string, CompactPolynomial>> loaded_compact;
+    std::vector<std::pair<std::string, DiskPolynomial>> loaded_disk;
+    for (std::uint64_t i = 0; i < header.count; ++i) {
+        IndexEntry entry;
+        std::memcpy(&entry, data + sizeof(Header) + i * sizeof(IndexEntry), sizeof(entry));
+        check_range(entry.name_offset, entry.name_length, size);
+        const std::uint32_t last_kind = header.version < 3 ? DISK : COMPACT;
+        if (entry.kind > last_kind || entry.terms_offset % alignof(double) != 0) {
+            throw std::runtime_error("快照不完整或已损坏");
+        }
+        std::string name(data + entry.name_offset, entry.name_length);
+        const char *terms = data + entry.terms_offset;
+        switch (entry.kind) {
+        case LIST: {
+            check_records(entry.terms_offset, entry.term_count, sizeof(double) + sizeof(std::int32_t), size);
+            const auto *coefficients = reinterpret_cast<const double *>(terms);
+            const auto *exponents = reinterpret_cast<const std::int32_t *>(terms + entry.term_count * sizeof(double));
+            loaded.emplace_back(std::move(name), Polynomial::fromSortedTerms(coefficients, exponents, entry.term_count));
+            break;
+        }
+        case MULTI: {
+            check_range(entry.terms_offset, MultiPolynomial::MAX_VARIABLES, size);
+            check_records(entry.terms_offset + MultiPolynomial::MAX_VARIABLES, entry.term_count, sizeof(MultiTerm), size);
+            std::string variables(terms, MultiPolynomial::MAX_VARIABLES);
+            variables.resize(variables.find('\0') == std::string::npos ? variables.size() : variables.find('\0'));
+            const auto *records = reinterpret_cast<const MultiTerm *>(terms + MultiPolynomial::MAX_VARIABLES);
+            loaded_multi.emplace_back(std::move(name), MultiPolynomial::fromSortedTerms(std::move(variables), records, entry.term_count));
+            break;
+        }
+        case COMPACT: {
+            check_records(entry.terms_offset, entry.term_count, sizeof(CompactPolynomial::Term), size);
+            const auto *records = reinterpret_cast<const CompactPolynomial::Term *>(terms);
+            CompactPolynomial::Builder builder; // rejects records out of order
+            for (std::uint64_t t = 0; t < entry.term_count; ++t) {
+                builder.append(records[t].coefficient, records[t].exponent);
+            }
+            loaded_compact.emplace_back(std::move(name), builder.finish());
+            break;
+        }
+        case DISK: {
+            check_records(entry.terms_offset, entry.term_count, sizeof(DiskPolynomial::Term), size);
+            // the writer rejects records out of order, as from a corrupt file
+            const auto *records = reinterpret_cast<const DiskPolynomial::Term *>(terms);
+            loaded_disk.emplace_back(std::move(name), DiskPolynomial::fromSortedTerms(records, entry.term_count, limits));
+            break;
+        }
+        }
+    }
+    std::size_t count = loaded.size() + loaded_multi.size() + loaded_compact.size() + loaded_disk.size();
+    store.put_all(std::move(loaded));
+    multi_store.put_all(std::move(loaded_multi));
+    compact_store.put_all(std::move(loaded_compact));
+    disk_store.put_all(std::move(loaded_disk));
+    return count;
+}
@@ -0,0 +1,129 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <map>
+#include <mutex>
+
+namespace stats {
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadCounters *> live;
+    std::array<std::uint64_t, COUNTER_COUNT> retired{}; // totals of exited threads
+    std::array<std::uint64_t, COUNTER_COUNT> baseline{}; // totals at the last reset()
+    std::map<std::string, CommandLatency> latencies;
+};
+
+Registry &registry() {
+    static Registry *instance = new Registry; // never destroyed, threads may outlive main
+    return *instance;
+}
+
+struct Registration {
+    // folds the counters of an exiting thread into the retired totals
+    ~Registration() {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (std::size_t i = 0; i < COUNTER_COUNT; ++i) {
+            reg.retired[i] += thread_counters.values[i].load(std::memory_order_relaxed);
+            thread_counters.values[i].store(0, std::memory_order_relaxed);
+        }
+        reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), &thread_counters), reg.live.end());
+        thread_counters.registered = false;
+    }
+};
+
+// everything counted since the start, under reg.mutex
+std::array<std::uint64_t, COUNTER_COUNT> totals(const Registry &reg) {
+    std::array<std::uint64_t, COUNTER_COUNT> result = reg.retired;
+    for (const ThreadCounters *counters : reg.live) {
+        for (std::size_t i = 0; i < COUNTER_COUNT; ++i) {
+            result[i] += counters->values[i].load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+constinit thread_local ThreadCounters thread_counters;
+
+void register_thread() {
+    thread_local Registration registration;
+    (void)registration;
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.live.push_back(&thread_counters);
+    thread_counters.registered = true;
+}
+
+std::uint64_t CommandLatency::percentile_ns(double fraction) const {
+    std::uint64_t target = static_cast<std::uint64_t>(fraction * static_cast<double>(count));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen > target) {
+            return std::min<std::uint64_t>(std::uint64_t{1} << i, max_ns);
+        }
+    }
+    return max_ns;
+}
+
+const char *counter_name(Counter counter) {
+    switch (counter) {
+    case Counter::GcdCalls:
+        return "gcd_calls";
+    case Counter::StackGrowths:
+        return "stack_growths";
+    case Counter::TermInserts:
+        return "term_inserts";
+    case Counter::TermAllocations:
+        return "term_allocations";
+    case Counter::TermFrees:
+        return "term_frees";
+    default:
+        return "unknown";
+    }
+}
+
+void record_latency(const std::string &command, std::uint64_t nanoseconds) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    CommandLatency &entry = reg.latencies[command];
+    entry.command = command;
+    ++entry.count;
+    entry.total_ns += nanoseconds;
+    entry.max_ns = std::max(entry.max_ns, nanoseconds);
+    std::size_t bucket = std::min<std::size_t>(std::bit_width(nanoseconds), LATENCY_BUCKETS - 1);
+    ++entry.buckets[bucket];
+}
+
+Snapshot snapshot() {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    Snapshot result;
+    result.counters = totals(reg);
+    for (std::size_t i = 0; i < COUNTER_COUNT; ++i) {
+        // an increment racing with reset() lands on either side of it, and
+        // the totals never go down, so this cannot wrap
+        result.counters[i] -= std::min(result.counters[i], reg.baseline[i]);
+    }
+    for (const auto &entry : reg.latencies) {
+        result.commands.push_back(entry.second);
+    }
+    return result;
+}
+
+void reset() {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    // the counters are only written by their own threads; clearing them here
+    // would be undone by an increment that loaded the old value
+    reg.baseline = totals(reg);
+    reg.latencies.clear();
+}
+
+} // namespace stats
@@ -0,0 +1,155 @@
+#include "thread_pool.hpp"
+#include "cancel.hpp"
+
+namespace {
+
+// identifies the pool and queue of the current worker thread
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local std::size_t current_index = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t threads) : pending_(0), next_queue_(0), stopping_(false) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // workers push onto their own deque, other threads spread round-robin
+    std::size_t index = current_pool == this ? current_index : next_queue_++ % queues_.size();
+    {
+        // count first so that pending_ never drops below the queued tasks
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        ++pending_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::try_pop(std::size_t self, std::function<void()> &task) {
+    {
+        Queue &own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --pending_;
+            return true;
+        }
+    }
+    for (std::size_t offset = 1; offset < queues_.size(); ++offset) {
+        Queue &victim = *queues_[(self + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --pending_;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::run_pending() {
+    if (pending_ == 0) {
+        return false;
+    }
+    std::size_t self = current_pool == this ? current_index : next_queue_++ % queues_.size();
+    std::function<void()> task;
+    if (!try_pop(self, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+std::size_t ThreadPool::size() const {
+    return threads_.size();
+}
+
+ThreadPool &ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::worker_loop(std::size_t index) {
+    current_pool = this;
+    current_index = index;
+    while (true) {
+        std::function<void()> task;
+        if (try_pop(index, task)) {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wake_.wait(lock, [this] { return stopping_ || pending_ > 0; });
+        if (stopping_ && pending_ == 0) {
+            return;
+        }
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool &pool) : pool_(pool), outstanding_(0) {}
+
+TaskGroup::~TaskGroup() {
+    // tasks may reference the caller's locals, never leave them running
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    ++outstanding_;
+    // the task checks the cancellation token of the command that queued it
+    pool_.submit([this, token = cancel::current, task = std::move(task)] {
+        try {
+            cancel::Adopt adopt(token);
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+        --outstanding_;
+    });
+}
+
+void TaskGroup::wait() {
+    while (outstanding_ > 0) {
+        if (!pool_.run_pending()) {
+            std::this_thread::yield();
+        }
+    }
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,217 @@
+#include "trace.hpp"
+
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+namespace trace {
+
+namespace {
+
+struct Event {
+    const char *name;
+    std::uint64_t start_ns;
+    std::uint64_t end_ns;
+};
+
+// events live in fixed-size chunks that are never moved, so stop() can read
+// everything published so far while the owner keeps appending
+struct Chunk {
+    static constexpr std::size_t CAPACITY = 4096;
+
+    Event events[CAPACITY];
+    std::atomic<std::size_t> count{0};
+    std::atomic<Chunk *> next{nullptr};
+};
+
+struct ThreadBuffer {
+    std::uint32_t tid = 0;
+    std::atomic<std::uint64_t> generation{0};
+    std::unique_ptr<Chunk> first;
+    Chunk *last = nullptr;
+    std::atomic<bool> exited{false};
+
+    void clear() {
+        Chunk *chunk = first ? first->next.load() : nullptr;
+        while (chunk) {
+            Chunk *next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+        first = std::make_unique<Chunk>();
+        last = first.get();
+    }
+    ~ThreadBuffer() {
+        if (first) {
+            Chunk *chunk = first->next.load();
+            while (chunk) {
+                Chunk *next = chunk->next.load();
+                delete chunk;
+                chunk = next;
+            }
+        }
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::unordered_set<std::string> names;
+    std::string path;
+    std::atomic<std::uint64_t> generation{0};
+    std::uint32_t next_tid = 1;
+};
+
+Registry &registry() {
+    static Registry *instance = new Registry; // worker threads may outlive main
+    return *instance;
+}
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+struct Registration {
+    ThreadBuffer *buffer = nullptr;
+
+    ~Registration() {
+        if (buffer) {
+            buffer->exited = true;
+        }
+    }
+};
+
+thread_local Registration registration;
+
+ThreadBuffer &local_buffer() {
+    Registry &reg = registry();
+    if (!registration.buffer) {
+        auto buffer = std::make_unique<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffer->tid = reg.next_tid++;
+        registration.buffer = buffer.get();
+        reg.buffers.push_back(std::move(buffer));
+    }
+    ThreadBuffer &buffer = *registration.buffer;
+    std::uint64_t generation = reg.generation.load(std::memory_order_acquire);
+    if (buffer.generation != generation) {
+        // first event since trace::start(), drop what an earlier session left
+        buffer.clear();
+        buffer.generation.store(generation, std::memory_order_release);
+    }
+    return buffer;
+}
+
+// a JSON string literal; names come from user commands and may hold quotes,
+// backslashes or control characters
+void write_string(std::ostream &out, const char *text) {
+    out << '"';
+    for (const char *p = text; *p; ++p) {
+        const auto c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\') {
+            out << '\\' << *p;
+        } else if (c < 0x20) {
+            static const char hex[] = "0123456789abcdef";
+            out << "\\u00" << hex[c >> 4] << hex[c & 15];
+        } else {
+            out << *p;
+        }
+    }
+    out << '"';
+}
+
+void write_json(std::ostream &out, Registry &reg) {
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    std::uint64_t generation = reg.generation.load();
+    for (const auto &buffer : reg.buffers) {
+        if (buffer->generation.load(std::memory_order_acquire) != generation || !buffer->first) {
+            continue;
+        }
+        if (!first) {
+            out << ',';
+        }
+        first = false;
+        out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"thread " << buffer->tid << "\"}}";
+        for (const Chunk *chunk = buffer->first.get(); chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            std::size_t count = chunk->count.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < count; ++i) {
+                const Event &event = chunk->events[i];
+                out << ",\n{\"name\":";
+                write_string(out, event.name);
+                out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                    << ",\"ts\":" << static_cast<double>(event.start_ns) / 1e3
+                    << ",\"dur\":" << static_cast<double>(event.end_ns - event.start_ns) / 1e3 << '}';
+            }
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+} // namespace
+
+std::uint64_t now_ns() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void record(const char *name, std::uint64_t start_ns, std::uint64_t end_ns) {
+    ThreadBuffer &buffer = local_buffer();
+    Chunk *chunk = buffer.last;
+    std::size_t count = chunk->count.load(std::memory_order_relaxed);
+    if (count == Chunk::CAPACITY) {
+        Chunk *next = new Chunk;
+        chunk->next.store(next, std::memory_order_release);
+        buffer.last = next;
+        chunk = next;
+        count = 0;
+    }
+    chunk->events[count] = Event{name, start_ns, end_ns};
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+const char *intern(const std::string &name) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.names.insert(name).first->c_str();
+}
+
+void start(const std::string &path) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (enabled) {
+        throw std::runtime_error("跟踪已经开启");
+    }
+    // buffers of threads that have exited are no longer referenced by anyone
+    std::erase_if(reg.buffers, [](const auto &buffer) { return buffer->exited.load(); });
+    reg.path = path;
+    reg.generation.fetch_add(1, std::memory_order_release);
+    enabled = true;
+}
+
+void stop() {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (!enabled) {
+        return;
+    }
+    enabled = false;
+    std::ofstream out(reg.path);
+    if (!out) {
+        throw std::runtime_error(std::format("无法打开跟踪文件 {}", reg.path));
+    }
+    write_json(out, reg);
+    if (!out) {
+        throw std::runtime_error(std::format("写入跟踪文件 {} 失败", reg.path));
+    }
+}
+
+bool active() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+} // namespace trace
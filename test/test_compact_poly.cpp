@@ -0,0 +1,42 @@
+#include <iostream>
+#include "compact_poly.hpp"
+
+// each case reads two polynomials ("n c1 e1 ...", 64-bit exponents in any
+// order) and an operation: + - * on both, d (derivative of the first),
+// e x (evaluate the first), t (convert the first to a regular polynomial),
+// s (size of the sum: terms, runs and its value at 0.5)
+int main() {
+    freopen("compact_poly.in", "r", stdin);
+    freopen("compact_poly.out", "w", stdout);
+
+    int T;
+    std::cin >> T;
+    while (T--) {
+        CompactPolynomial a = CompactPolynomial::read(std::cin);
+        CompactPolynomial b = CompactPolynomial::read(std::cin);
+        char op;
+        std::cin >> op;
+        try {
+            if (op == '+') {
+                (a + b).print();
+            } else if (op == '-') {
+                (a - b).print();
+            } else if (op == '*') {
+                (a * b).print();
+            } else if (op == 'd') {
+                a.derivative().print();
+            } else if (op == 'e') {
+                double x;
+                std::cin >> x;
+                std::cout << a.evaluate(x) << std::endl;
+            } else if (op == 't') {
+                a.toPolynomial().print();
+            } else if (op == 's') {
+                CompactPolynomial sum = a + b;
+                std::cout << sum.termCount() << " terms, " << sum.runCount() << " runs, " << sum.evaluate(0.5) << std::endl;
+            }
+        } catch (const std::exception &e) {
+            std::cout << "错误：" << e.what() << std::endl;
+        }
+    }
+}
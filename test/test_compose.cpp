@@ -0,0 +1,78 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include "polynomial.hpp"
+
+// p(q(x)) by Horner's rule over Polynomial products, exact for the small
+// integer coefficients used here
+Polynomial naive_compose(const Polynomial &p, const Polynomial &q) {
+    Polynomial result;
+    int previous = -1;
+    for (const PolyTerm *term = p.terms(); term; term = term->next) {
+        for (int k = previous; k > term->exponent; --k) {
+            result = result * q;
+        }
+        Polynomial constant;
+        constant.addTerm(term->coefficient, 0);
+        result = previous < 0 ? constant : result + constant;
+        previous = term->exponent;
+    }
+    for (int k = previous; k > 0; --k) {
+        result = result * q;
+    }
+    return result;
+}
+
+// largest coefficient difference, relative to the largest exact coefficient
+double relative_error(const Polynomial &result, const Polynomial &exact) {
+    double scale = 1.0;
+    for (const PolyTerm *term = exact.terms(); term; term = term->next) {
+        scale = std::max(scale, std::abs(term->coefficient));
+    }
+    Polynomial difference = result - exact;
+    double error = 0.0;
+    for (const PolyTerm *term = difference.terms(); term; term = term->next) {
+        error = std::max(error, std::abs(term->coefficient));
+    }
+    return error / scale;
+}
+
+// each case: c P Q (compose) or s P a (shift), polynomials as "n c1 e1 ...".
+// small results are printed rounded to 6 decimals, every result is checked
+// against the exact one
+int main() {
+    freopen("compose.in", "r", stdin);
+    freopen("compose.out", "w", stdout);
+
+    int T;
+    std::cin >> T;
+    while (T--) {
+        char op;
+        std::cin >> op;
+        Polynomial p = createPoly();
+        Polynomial q;
+        double a = 0.0;
+        if (op == 'c') {
+            q = createPoly();
+        } else {
+            std::cin >> a;
+            q.addTerm(1.0, 1);
+            q.addTerm(a, 0);
+        }
+        try {
+            Polynomial result = op == 'c' ? p.compose(q) : p.shift(a);
+            double error = relative_error(result, naive_compose(p, q));
+            std::printf("%zu terms, %s", result.termCount(), error < 1e-9 ? "matches" : "DIFFERS");
+            if (result.termCount() <= 12) {
+                std::printf(":");
+                for (const PolyTerm *term = result.terms(); term; term = term->next) {
+                    double c = std::round(term->coefficient * 1e6) / 1e6;
+                    std::printf(" %g x^%d", c == 0.0 ? 0.0 : c, term->exponent);
+                }
+            }
+            std::printf("\n");
+        } catch (const std::exception &e) {
+            std::printf("错误：%s\n", e.what());
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "disk_poly.hpp"
+
+// a polynomial of the input: "n c1 e1 ..." as given, or "g n range seed"
+// for n random terms with exponents in [0, range), unsorted and repeated
+std::string read_input() {
+    std::string first;
+    std::cin >> first;
+    std::ostringstream text;
+    if (first == "g") {
+        int count;
+        std::int64_t range;
+        unsigned seed;
+        std::cin >> count >> range >> seed;
+        std::mt19937_64 random(seed);
+        text << count;
+        for (int i = 0; i < count; ++i) {
+            text << " " << static_cast<int>(random() % 19) - 9 << " " << static_cast<std::int64_t>(random() % range);
+        }
+    } else {
+        int count = std::stoi(first);
+        text << count;
+        for (int i = 0; i < 2 * count; ++i) {
+            std::string token;
+            std::cin >> token;
+            text << " " << token;
+        }
+    }
+    return text.str();
+}
+
+// each case reads the working memory in bytes, an operation and two
+// polynomials: + - * on both, t (load the first into memory). The result
+// computed on disk is compared with the in-memory CompactPolynomial one;
+// short results are printed
+int main() {
+    freopen("disk_poly.in", "r", stdin);
+    freopen("disk_poly.out", "w", stdout);
+
+    int T;
+    std::cin >> T;
+    while (T--) {
+        DiskLimits limits;
+        char op;
+        std::cin >> limits.memory_bytes >> op;
+        std::string a_text = read_input();
+        std::string b_text = read_input();
+        try {
+            std::istringstream a_in(a_text), b_in(b_text), a_mem(a_text), b_mem(b_text);
+            DiskPolynomial a = DiskPolynomial::read(a_in, limits);
+            DiskPolynomial b = DiskPolynomial::read(b_in, limits);
+            CompactPolynomial a_compact = CompactPolynomial::read(a_mem);
+            CompactPolynomial b_compact = CompactPolynomial::read(b_mem);
+
+            DiskPolynomial result;
+            CompactPolynomial expected;
+            if (op == '+') {
+                result = DiskPolynomial::add(a, b, limits);
+                expected = a_compact + b_compact;
+            } else if (op == '-') {
+                result = DiskPolynomial::subtract(a, b, limits);
+                expected = a_compact - b_compact;
+            } else if (op == '*') {
+                result = DiskPolynomial::multiply(a, b, limits);
+                expected = a_compact * b_compact;
+            } else if (op == 't') {
+                result = a;
+                expected = a.toCompact(limits);
+            }
+
+            std::ostringstream disk_text, memory_text;
+            result.print(disk_text);
+            expected.print(memory_text);
+            std::cout << result.termCount() << " terms, " << result.evaluate(0.999) << " at 0.999, "
+                      << (disk_text.str() == memory_text.str() ? "matches" : "DIFFERS") << std::endl;
+            if (result.termCount() <= 8) {
+                std::cout << disk_text.str();
+            }
+        } catch (const std::exception &e) {
+            std::cout << "错误：" << e.what() << std::endl;
+        }
+    }
+}
@@ -1,6 +1,27 @@
 #include <iostream>
 #include "expression.hpp"
 
+// the parser, Fraction and Stack must stay usable in constant expressions;
+// these fail the build if a change makes any of them run-time only
+static_assert("(20+2)*(6/2)"_frac == Fraction(66, 1));
+static_assert("1/3 + 1/6"_frac == Fraction(1, 2));
+static_assert("2 ^ 10 - 3 * 4"_frac == Fraction(1012, 1));
+
+constexpr int stack_round_trip(int count) {
+    Stack<int> stack; // more pushes than the default capacity, so it grows
+    for (int i = 1; i <= count; ++i) {
+        stack.push(i);
+    }
+    Stack<int> copy = stack;
+    for (int expected = count; expected >= 1; --expected) {
+        if (copy.pop() != expected) {
+            return -1;
+        }
+    }
+    return copy.empty() ? stack.top() + static_cast<int>(stack.size()) : -1;
+}
+static_assert(stack_round_trip(20) == 40);
+
 int main() {
     freopen("expression.in", "r", stdin);
     char s[10000];
@@ -9,7 +30,7 @@ int main() {
     while (T--) {
         try {
             std::cin.getline(s, 10000);
-            expression_evaluate(s).println();
+            std::cout << expression_evaluate(s) << std::endl;
         } catch (const std::exception &e) {
             std::cout << "Error: " << e.what() << std::endl;
         }
@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "multipoly.hpp"
+
+// one case per line: an operation and its operands separated by '|'
+//   p | f          parse and print
+//   + | f | g      also - and *
+//   d | f | x      partial derivative
+//   e | f | 1 2    evaluate at the values of the variables, in order
+int main() {
+    freopen("multipoly.in", "r", stdin);
+    freopen("multipoly.out", "w", stdout);
+
+    std::string line;
+    std::getline(std::cin, line);
+    int T = std::stoi(line);
+    while (T-- && std::getline(std::cin, line)) {
+        std::vector<std::string> fields;
+        std::istringstream iss(line);
+        for (std::string field; std::getline(iss, field, '|');) {
+            fields.push_back(field);
+        }
+        fields.resize(std::max<std::size_t>(fields.size(), 3)); // getline drops a trailing empty field
+        char op = fields[0].find_first_not_of(' ') == std::string::npos ? ' ' : fields[0][fields[0].find_first_not_of(' ')];
+        try {
+            MultiPolynomial f = MultiPolynomial::parse(fields[1]);
+            if (op == 'p') {
+                f.print();
+            } else if (op == '+') {
+                (f + MultiPolynomial::parse(fields[2])).print();
+            } else if (op == '-') {
+                (f - MultiPolynomial::parse(fields[2])).print();
+            } else if (op == '*') {
+                (f * MultiPolynomial::parse(fields[2])).print();
+            } else if (op == 'd') {
+                f.partialDerivative(fields[2][fields[2].find_first_not_of(' ')]).print();
+            } else if (op == 'e') {
+                std::vector<double> values;
+                std::istringstream numbers(fields[2]);
+                for (double value; numbers >> value;) {
+                    values.push_back(value);
+                }
+                std::cout << f.evaluate(values) << std::endl;
+            }
+        } catch (const std::exception &e) {
+            std::cout << "错误：" << e.what() << std::endl;
+        }
+    }
+}
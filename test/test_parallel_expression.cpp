@@ -0,0 +1,75 @@
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "expression.hpp"
+#include "thread_pool.hpp"
+
+// terms a * b / c joined by + and -, every group of ten in parentheses; the
+// divisors divide 40 so the sum stays small. zero_at makes that term divide
+// by zero, an error deep inside one of the parallel parts
+std::string generate(int terms, unsigned seed, int zero_at) {
+    std::mt19937 random(seed);
+    const int divisors[] = {1, 2, 4, 5, 8};
+    std::string expr;
+    for (int i = 0; i < terms; ++i) {
+        if (i > 0) {
+            expr += random() % 2 ? " + " : " - ";
+        }
+        if (i % 10 == 0 && i + 10 <= terms) {
+            expr += "(";
+        }
+        expr += std::to_string(random() % 9 + 1) + " * " + std::to_string(random() % 9 + 1) + " / ";
+        expr += i == zero_at ? "0" : std::to_string(divisors[random() % 5]);
+        if (i % 10 == 9 && i < terms - terms % 10) {
+            expr += ")";
+        }
+    }
+    return expr;
+}
+
+std::string result_of(Fraction (*evaluate)(const std::string &), const std::string &expr) {
+    std::ostringstream out;
+    try {
+        out << evaluate(expr);
+    } catch (const std::exception &e) {
+        out << "Error: " << e.what();
+    }
+    return out.str();
+}
+
+ThreadPool pool(4);
+
+Fraction parallel(const std::string &expr) {
+    return expression_evaluate_parallel(expr, pool);
+}
+
+Fraction serial(const std::string &expr) {
+    return expression_evaluate(expr);
+}
+
+// each line is an expression, or "g terms seed zero_at" for a generated one
+// (zero_at -1: no division by zero). Both evaluators must give the same
+// result or the same error
+int main() {
+    freopen("parallel_expression.in", "r", stdin);
+    freopen("parallel_expression.out", "w", stdout);
+
+    std::string line;
+    std::getline(std::cin, line);
+    int T = std::stoi(line);
+    while (T--) {
+        std::getline(std::cin, line);
+        std::string expr = line;
+        if (line.rfind("g ", 0) == 0) {
+            std::istringstream spec(line.substr(2));
+            int terms, zero_at;
+            unsigned seed;
+            spec >> terms >> seed >> zero_at;
+            expr = generate(terms, seed, zero_at);
+        }
+        std::string expected = result_of(serial, expr);
+        std::string actual = result_of(parallel, expr);
+        std::cout << expected << (actual == expected ? " same" : " DIFFERS: " + actual) << std::endl;
+    }
+}
@@ -0,0 +1,232 @@
+// performance regression gate: runs a fixed workload set and compares the
+// best-of-N time and the allocation count of each workload with
+// performance.baseline; exits with 1 when anything regressed
+//
+//   test_performance [--update] [--time-tolerance 0.5] [--alloc-tolerance 0.1]
+//
+// tolerances are relative (0.5 = 50% slower is still accepted) and can also be
+// set through CALC_PERF_TIME_TOLERANCE / CALC_PERF_ALLOC_TOLERANCE
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "expression.hpp"
+#include "polynomial.hpp"
+#include "stack.hpp"
+#include "thread_pool.hpp"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace {
+
+std::atomic<unsigned long long> allocation_count{0};
+
+} // namespace
+
+void *operator new(std::size_t size) {
+    ++allocation_count;
+    if (void *p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+constexpr int REPEATS = 7;
+
+volatile double sink;
+
+struct Measurement {
+    double time_ns;
+    unsigned long long allocations;
+};
+
+struct Workload {
+    std::string name;
+    std::function<void()> body;
+};
+
+std::string sum_of_products(int count) {
+    std::string expr;
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) {
+            expr += i % 3 ? '+' : '-';
+        }
+        expr += "(" + std::to_string(i % 7 + 1) + "*" + std::to_string(i % 5 + 1) + ")";
+    }
+    return expr;
+}
+
+Polynomial make_polynomial(int terms, bool sparse) {
+    // sparse exponents are squares, so products have few colliding terms
+    Polynomial poly;
+    for (int i = 0; i < terms; ++i) {
+        poly.addTerm(1.0 + i % 13, sparse ? i * i : i);
+    }
+    return poly;
+}
+
+std::vector<Workload> workloads() {
+    static const std::string expr = sum_of_products(20000);
+    static const Polynomial dense = make_polynomial(2000, false);
+    static const Polynomial dense_small = make_polynomial(200, false);
+    static const Polynomial sparse = make_polynomial(60, true);
+    // a fixed pool, so the split path is measured whatever the core count
+    static ThreadPool pool(4);
+    return {
+        {"expr_serial_20k", [] { sink = static_cast<double>(expression_evaluate(expr).numerator); }},
+        {"expr_parallel_20k", [] { sink = static_cast<double>(expression_evaluate_parallel(expr, pool).numerator); }},
+        {"stack_push_pop_100k", [] {
+            Stack<Fraction> stack;
+            for (int i = 0; i < 100000; ++i) {
+                stack.push(Fraction(i, 1));
+            }
+            while (!stack.empty()) {
+                sink = static_cast<double>(stack.pop().numerator);
+            }
+        }},
+        {"poly_add_dense_2000", [] { sink = (dense + dense).evaluate(0.5); }},
+        {"poly_mul_dense_200", [] { sink = (dense_small * dense_small).evaluate(0.5); }},
+        {"poly_mul_sparse_60", [] { sink = (sparse * sparse).evaluate(0.5); }},
+        {"poly_deriv_dense_2000", [] { sink = dense.derivative().evaluate(0.5); }},
+        {"poly_eval_dense_2000", [] {
+            for (int i = 0; i < 100; ++i) {
+                sink = dense.evaluate(0.999);
+            }
+        }},
+    };
+}
+
+Measurement measure(const std::function<void()> &body) {
+    body(); // warm up caches and lazily created state such as the thread pool
+    Measurement best{0.0, 0};
+    for (int i = 0; i < REPEATS; ++i) {
+        unsigned long long before = allocation_count;
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        unsigned long long allocations = allocation_count - before;
+        if (i == 0 || elapsed < best.time_ns) {
+            best.time_ns = elapsed;
+        }
+        if (i == 0 || allocations < best.allocations) {
+            best.allocations = allocations;
+        }
+    }
+    return best;
+}
+
+double tolerance_option(const char *env, double fallback) {
+    const char *value = std::getenv(env);
+    return value ? std::strtod(value, nullptr) : fallback;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+#ifdef __GLIBC__
+    // glibc raises its mmap and trim thresholds as large blocks are freed, so
+    // whether a workload's big buffers come from warm heap or from fresh
+    // mmapped pages would depend on the workloads run before it. Fixed
+    // thresholds keep every measurement independent of that order
+    mallopt(M_MMAP_THRESHOLD, 64 << 20);
+    mallopt(M_TRIM_THRESHOLD, 256 << 20);
+#endif
+    bool update = false;
+    double time_tolerance = tolerance_option("CALC_PERF_TIME_TOLERANCE", 0.5);
+    double alloc_tolerance = tolerance_option("CALC_PERF_ALLOC_TOLERANCE", 0.1);
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--update") {
+            update = true;
+        } else if (arg == "--time-tolerance" && i + 1 < argc) {
+            time_tolerance = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--alloc-tolerance" && i + 1 < argc) {
+            alloc_tolerance = std::strtod(argv[++i], nullptr);
+        } else {
+            // a mistyped --update must not quietly run the gate instead
+            bool known = arg == "--time-tolerance" || arg == "--alloc-tolerance";
+            std::cerr << (known ? "missing value for " : "unknown option ") << arg << "\n"
+                      << "usage: test_performance [--update] [--time-tolerance 0.5] [--alloc-tolerance 0.1]\n";
+            return 2;
+        }
+    }
+
+    std::map<std::string, Measurement> baseline;
+    if (!update) {
+        std::ifstream in("performance.baseline");
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string name;
+            Measurement m;
+            if (!line.empty() && line[0] != '#' && fields >> name >> m.time_ns >> m.allocations) {
+                baseline[name] = m;
+            }
+        }
+        if (baseline.empty()) {
+            std::cout << "Error: performance.baseline is missing, run with --update to create it" << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream out;
+    if (update) {
+        out.open("performance.baseline");
+        out << "# workload time_ns allocations\n";
+    }
+
+    int failures = 0;
+    for (const Workload &workload : workloads()) {
+        Measurement m = measure(workload.body);
+        if (update) {
+            out << workload.name << ' ' << static_cast<long long>(m.time_ns) << ' ' << m.allocations << '\n';
+            std::cout << workload.name << ": " << m.time_ns / 1e6 << " ms, " << m.allocations << " allocations" << std::endl;
+            continue;
+        }
+        auto it = baseline.find(workload.name);
+        if (it == baseline.end()) {
+            std::cout << workload.name << ": no baseline" << std::endl;
+            ++failures;
+            continue;
+        }
+        const Measurement &base = it->second;
+        bool slow = m.time_ns > base.time_ns * (1.0 + time_tolerance);
+        bool allocs = static_cast<double>(m.allocations) > static_cast<double>(base.allocations) * (1.0 + alloc_tolerance);
+        std::cout << (slow || allocs ? "FAIL " : "ok   ") << workload.name << ": "
+                  << m.time_ns / 1e6 << " ms (baseline " << base.time_ns / 1e6 << "), "
+                  << m.allocations << " allocations (baseline " << base.allocations << ")" << std::endl;
+        failures += slow || allocs;
+    }
+    return failures == 0 ? 0 : 1;
+}
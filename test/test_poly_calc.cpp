@@ -0,0 +1,40 @@
+#include <iostream>
+#include <string>
+#include "poly_calc.hpp"
+
+// the first line gives the number of stored polynomials, each then given as
+// "name n c1 e1 ...", followed by a count and one expression per line
+int main() {
+    freopen("poly_calc.in", "r", stdin);
+    freopen("poly_calc.out", "w", stdout);
+
+    PolyStore store;
+    int count;
+    std::cin >> count;
+    while (count--) {
+        std::string name;
+        std::cin >> name;
+        store.put(name, createPoly());
+    }
+    auto lookup = [&store](const std::string &name) {
+        PolyHandle poly = store.find(name);
+        if (!poly) {
+            throw std::runtime_error("未找到名为 '" + name + "' 的多项式");
+        }
+        return poly;
+    };
+
+    std::string line;
+    std::cin >> count;
+    std::getline(std::cin, line);
+    while (count-- && std::getline(std::cin, line)) {
+        try {
+            PolyCalcStats stats;
+            Polynomial result = poly_calc(line, lookup, &stats);
+            std::cout << "nodes " << stats.nodes << ", reused " << stats.reused << ", fused " << stats.fused << ": ";
+            result.print();
+        } catch (const std::exception &e) {
+            std::cout << "错误：" << e.what() << std::endl;
+        }
+    }
+}
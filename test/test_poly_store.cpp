@@ -0,0 +1,111 @@
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "poly_store.hpp"
+
+// the value written in round k: k + k x + ... + k x^(k % 7 + 1). A reader
+// that saw a torn or freed value would find other coefficients or lengths
+Polynomial make_value(int k) {
+    Polynomial poly;
+    for (int i = 0; i <= k % 7 + 1; ++i) {
+        poly.addTerm(k, i);
+    }
+    return poly;
+}
+
+bool is_valid(const Polynomial &poly) {
+    const PolyTerm *term = poly.terms();
+    if (!term) {
+        return false;
+    }
+    double k = term->coefficient;
+    std::size_t count = 0;
+    for (; term; term = term->next, ++count) {
+        if (term->coefficient != k) {
+            return false;
+        }
+    }
+    return count == static_cast<std::size_t>(static_cast<int>(k) % 7 + 2);
+}
+
+int main() {
+    freopen("poly_store.in", "r", stdin);
+    freopen("poly_store.out", "w", stdout);
+
+    int readers, writers, names, rounds;
+    std::cin >> readers >> writers >> names >> rounds;
+    auto name_of = [](int i) { return "p" + std::to_string(i); };
+
+    PolyStore store;
+    std::atomic<bool> writing{true};
+    std::atomic<long> bad_values{0};
+    std::atomic<long> failed_replaces{0};
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r] {
+            long hits = 0;
+            for (unsigned i = r; writing.load() || hits == 0; ++i) {
+                if (PolyHandle handle = store.find(name_of(static_cast<int>(i % names)))) {
+                    ++hits;
+                    if (!is_valid(*handle)) {
+                        ++bad_values;
+                    }
+                }
+                if (i % 64 == 0) {
+                    for (const auto &[name, value] : store.entries()) {
+                        if (!is_valid(*value)) {
+                            ++bad_values;
+                        }
+                    }
+                }
+            }
+        });
+    }
+    std::vector<std::thread> writer_threads;
+    for (int w = 0; w < writers; ++w) {
+        writer_threads.emplace_back([&, w] {
+            // every name has one writer, so its replaces must all succeed
+            for (int k = 1; k <= rounds; ++k) {
+                for (int i = w; i < names; i += writers) {
+                    std::string name = name_of(i);
+                    if (k % 5 == 0) {
+                        store.erase(name);
+                    }
+                    if (k % 3 == 0 && store.find(name)) {
+                        failed_replaces += !store.replace(name, store.find(name), make_value(k));
+                    } else {
+                        store.put(name, make_value(k));
+                    }
+                }
+            }
+        });
+    }
+    for (auto &thread : writer_threads) {
+        thread.join();
+    }
+    writing = false;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::cout << "bad values: " << bad_values << "\n";
+    std::cout << "failed replaces: " << failed_replaces << "\n";
+    std::cout << "size: " << store.size() << "\n";
+    for (const auto &[name, value] : store.entries()) {
+        std::cout << name << ": ";
+        value->print();
+    }
+
+    // a stale handle must not undo a newer value, and erase reports absence
+    PolyHandle stale = store.find(name_of(0));
+    store.put(name_of(0), make_value(1));
+    std::cout << "stale replace: " << store.replace(name_of(0), stale, make_value(2)) << "\n";
+    std::cout << "current: ";
+    store.find(name_of(0))->print();
+    std::cout << "erase: " << store.erase(name_of(0)) << " " << store.erase(name_of(0)) << "\n";
+    std::cout << "size: " << store.size() << "\n";
+}
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "polynomial.hpp"
+
+// a polynomial of the input: "p n c1 e1 ..." as createPoly reads it, or
+// "g n low high seed" for n random terms with exponents in [low, high)
+Polynomial read_input() {
+    std::string kind;
+    std::cin >> kind;
+    if (kind == "p") {
+        return createPoly(std::cin);
+    }
+    int count, low, high;
+    unsigned seed;
+    std::cin >> count >> low >> high >> seed;
+    std::mt19937 random(seed);
+    Polynomial poly;
+    for (int i = 0; i < count; ++i) {
+        double coefficient = static_cast<int>(random() % 19) - 9;
+        long long offset = random() % static_cast<unsigned>(static_cast<long long>(high) - low);
+        poly.addTerm(coefficient, static_cast<int>(low + offset));
+    }
+    return poly;
+}
+
+// agreement up to rounding: relative to sum |c x^e|, the size of the terms
+bool agrees(const Polynomial &poly, double x, double value, double expected) {
+    if (std::isnan(expected) || std::isinf(expected)) {
+        return std::isnan(value) == std::isnan(expected) && (std::isnan(value) || value == expected);
+    }
+    double scale = 0.0;
+    for (const PolyTerm *term = poly.terms(); term; term = term->next) {
+        scale += std::fabs(term->coefficient * std::pow(x, term->exponent));
+    }
+    return std::fabs(value - expected) <= 1e-12 * scale;
+}
+
+void check(const Polynomial &poly, const std::vector<double> &points) {
+    const PreparedEvaluator &evaluator = poly.prepared();
+    std::cout << poly.termCount() << " terms, " << evaluator.segmentCount() << " segments" << std::endl;
+    for (double x : points) {
+        double value = evaluator(x);
+        double expected = poly.evaluate(x);
+        std::cout << "  " << x << ": " << expected << " "
+                  << (agrees(poly, x, value, expected) ? "matches" : "DIFFERS") << std::endl;
+    }
+}
+
+// each case reads a polynomial, k points and a term to add afterwards; the
+// prepared evaluator is compared with evaluate at the points before and after
+// the change, which must drop the cached plan, and on a compacted copy
+int main() {
+    freopen("prepared.in", "r", stdin);
+    freopen("prepared.out", "w", stdout);
+    std::cout << std::setprecision(10);
+
+    int T;
+    std::cin >> T;
+    while (T--) {
+        Polynomial poly = read_input();
+        int k;
+        std::cin >> k;
+        std::vector<double> points(k);
+        for (double &x : points) {
+            std::cin >> x;
+        }
+        double coefficient;
+        int exponent;
+        std::cin >> coefficient >> exponent;
+
+        check(poly, points);
+        poly.addTerm(coefficient, exponent);
+        check(poly, points);
+        check(poly.compacted(), points);
+    }
+}
@@ -0,0 +1,39 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include "polynomial.hpp"
+
+// roots are printed to 4 decimals, sorted by the rounded values, so that the
+// last bits of the iteration (and the order of conjugates) do not show
+int main() {
+    freopen("roots.in", "r", stdin);
+    freopen("roots.out", "w", stdout);
+
+    int T;
+    std::cin >> T;
+    while (T--) {
+        Polynomial p = createPoly();
+        try {
+            std::vector<PolyRoot> roots = p.roots();
+            std::vector<std::pair<double, double>> rounded;
+            bool residuals_small = true;
+            for (const auto &root : roots) {
+                auto round = [](double x) {
+                    double r = std::round(x * 1e4) / 1e4;
+                    return r == 0.0 ? 0.0 : r; // no "-0.0000"
+                };
+                rounded.emplace_back(round(root.value.real()), round(root.value.imag()));
+                residuals_small = residuals_small && root.residual < 1e-6;
+            }
+            std::sort(rounded.begin(), rounded.end());
+            std::printf("%zu roots, residuals %s\n", roots.size(), residuals_small ? "small" : "large");
+            for (const auto &[re, im] : rounded) {
+                std::printf("  %.4f %+.4fi\n", re, im);
+            }
+        } catch (const std::exception &e) {
+            std::printf("错误：%s\n", e.what());
+        }
+    }
+}
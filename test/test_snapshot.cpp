@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "snapshot.hpp"
+
+// fills one store of each kind from snapshot.in, saves them, loads the file
+// into empty stores and prints what came back; then checks that damaged
+// files are rejected without touching the stores
+int main() {
+    freopen("snapshot.in", "r", stdin);
+    freopen("snapshot.out", "w", stdout);
+
+    PolyStore polynomials;
+    MultiPolyStore multipolys;
+    CompactPolyStore compacts;
+    DiskPolyStore disks;
+    DiskLimits limits;
+    limits.memory_bytes = 1 << 16;
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream iss(line);
+        std::string kind, name;
+        if (!(iss >> kind >> name)) {
+            continue;
+        }
+        if (kind == "list") {
+            polynomials.put(name, createPoly(iss));
+        } else if (kind == "multi") {
+            std::string text;
+            std::getline(iss, text);
+            multipolys.put(name, MultiPolynomial::parse(text));
+        } else if (kind == "compact") {
+            compacts.put(name, CompactPolynomial::read(iss));
+        } else if (kind == "disk") {
+            disks.put(name, DiskPolynomial::read(iss, limits));
+        }
+    }
+
+    save_snapshot("snapshot.bin", polynomials.entries(), multipolys.entries(), compacts.entries(), disks.entries());
+    // saving again replaces the file
+    save_snapshot("snapshot.bin", polynomials.entries(), multipolys.entries(), compacts.entries(), disks.entries());
+
+    PolyStore loaded;
+    MultiPolyStore loaded_multi;
+    CompactPolyStore loaded_compact;
+    DiskPolyStore loaded_disk;
+    std::cout << "loaded " << load_snapshot("snapshot.bin", loaded, loaded_multi, loaded_compact, loaded_disk, limits) << '\n';
+    for (const auto &[name, poly] : loaded.entries()) {
+        std::cout << "list " << name << ": ";
+        poly->print();
+    }
+    for (const auto &[name, poly] : loaded_multi.entries()) {
+        std::cout << "multi " << name << " (" << poly->variables() << "): ";
+        poly->print();
+    }
+    for (const auto &[name, poly] : loaded_compact.entries()) {
+        std::cout << "compact " << name << ": ";
+        poly->print();
+    }
+    for (const auto &[name, poly] : loaded_disk.entries()) {
+        std::cout << "disk " << name << ": ";
+        poly->print(std::cout);
+    }
+
+    std::ifstream in("snapshot.bin", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    auto try_load = [&](const char *label, const std::string &content) {
+        std::ofstream("snapshot.bad", std::ios::binary).write(content.data(), static_cast<std::streamsize>(content.size()));
+        PolyStore store;
+        MultiPolyStore multi_store;
+        CompactPolyStore compact_store;
+        DiskPolyStore disk_store;
+        try {
+            load_snapshot("snapshot.bad", store, multi_store, compact_store, disk_store, limits);
+            std::cout << label << ": loaded\n";
+        } catch (const std::exception &e) {
+            std::cout << label << ": " << e.what() << " (" << store.size() + multi_store.size() + compact_store.size() + disk_store.size() << " loaded)\n";
+        }
+    };
+    try_load("truncated", bytes.substr(0, bytes.size() - 1));
+    std::string huge_count = bytes;
+    huge_count[16 + 7] = 0x08; // count = 2^59 + n
+    try_load("index count overflow", huge_count);
+    std::string huge_terms = bytes;
+    huge_terms[32 + 16 + 7] = 0x40; // first entry, term_count = 2^62 + n
+    try_load("term count overflow", huge_terms);
+    std::remove("snapshot.bin");
+    std::remove("snapshot.bad");
+}
@@ -0,0 +1,104 @@
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "expression.hpp"
+#include "polynomial.hpp"
+#include "stats.hpp"
+
+void print_counters() {
+    stats::Snapshot snap = stats::snapshot();
+    for (std::size_t i = 0; i < stats::COUNTER_COUNT; ++i) {
+        auto counter = static_cast<stats::Counter>(i);
+        if (snap[counter] != 0) {
+            std::cout << " " << stats::counter_name(counter) << "=" << snap[counter];
+        }
+    }
+    std::cout << std::endl;
+}
+
+// each case reads an operation and its operands; the counters are reset
+// before it and printed after it:
+//   p <poly>          build a polynomial term by term
+//   + <poly> <poly>   the sum,  * <poly> <poly>  the product
+//   e <expression>    evaluate an expression (the rest of the line)
+// the last line gives threads and increments per thread for a reset that
+// races with the increments
+int main() {
+    freopen("stats.in", "r", stdin);
+    freopen("stats.out", "w", stdout);
+
+    int T;
+    std::cin >> T;
+    while (T--) {
+        char op;
+        std::cin >> op;
+        if (op == 'p') {
+            stats::reset();
+            Polynomial a = createPoly();
+            std::cout << "p:";
+        } else if (op == '+' || op == '*') {
+            Polynomial a = createPoly();
+            Polynomial b = createPoly();
+            stats::reset();
+            Polynomial c = op == '+' ? a + b : a * b;
+            std::cout << op << ":";
+        } else if (op == 'e') {
+            std::string expr;
+            std::getline(std::cin, expr);
+            stats::reset();
+            std::cout << "e " << expression_evaluate(expr) << ":";
+        }
+        print_counters();
+    }
+
+    // adds done before reset() starts must not be counted, and those made
+    // after a thread saw it return must be; the count lies between the two
+    int threads;
+    std::uint64_t per_thread;
+    std::cin >> threads >> per_thread;
+    std::vector<std::atomic<std::uint64_t>> done(threads);
+    std::vector<std::uint64_t> seen_reset(threads, per_thread);
+    std::atomic<bool> reset_done{false};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (std::uint64_t i = 0; i < per_thread; ++i) {
+                if (seen_reset[t] == per_thread && reset_done.load(std::memory_order_acquire)) {
+                    seen_reset[t] = i;
+                }
+                stats::add(stats::Counter::GcdCalls);
+                done[t].store(i + 1, std::memory_order_release);
+            }
+        });
+    }
+    auto sum_done = [&] {
+        std::uint64_t sum = 0;
+        for (auto &count : done) {
+            sum += count.load(std::memory_order_acquire);
+        }
+        return sum;
+    };
+    while (sum_done() < per_thread * threads / 2) {
+    }
+    std::uint64_t before = sum_done();
+    stats::reset();
+    reset_done.store(true, std::memory_order_release);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    std::uint64_t total = per_thread * threads;
+    std::uint64_t after = 0;
+    for (std::uint64_t first : seen_reset) {
+        after += first;
+    }
+    std::uint64_t counted = stats::snapshot()[stats::Counter::GcdCalls];
+    std::cout << "racing reset: " << (counted <= total - before && counted >= total - after ? "within bounds" : "OUT OF BOUNDS")
+              << std::endl;
+    stats::reset();
+    stats::add(stats::Counter::GcdCalls, 5);
+    std::cout << "after reset:";
+    print_counters();
+}
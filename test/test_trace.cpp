@@ -0,0 +1,237 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "trace.hpp"
+
+// a strict JSON reader, just enough to check the trace file: it parses the
+// whole document and collects the decoded value of every "name" key
+class JsonReader {
+public:
+    explicit JsonReader(std::string text) : text_(std::move(text)) {}
+
+    std::vector<std::string> names;
+
+    bool parse() {
+        skip_space();
+        if (!value()) {
+            return false;
+        }
+        skip_space();
+        return pos_ == text_.size();
+    }
+
+private:
+    std::string text_;
+    std::size_t pos_ = 0;
+
+    void skip_space() {
+        while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\n' || text_[pos_] == '\r' || text_[pos_] == '\t')) {
+            ++pos_;
+        }
+    }
+
+    bool eat(char c) {
+        skip_space();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    bool string(std::string &out) {
+        if (!eat('"')) {
+            return false;
+        }
+        while (pos_ < text_.size()) {
+            auto c = static_cast<unsigned char>(text_[pos_++]);
+            if (c == '"') {
+                return true;
+            }
+            if (c < 0x20) {
+                return false; // raw control characters are not allowed
+            }
+            if (c != '\\') {
+                out += static_cast<char>(c);
+                continue;
+            }
+            if (pos_ >= text_.size()) {
+                return false;
+            }
+            char escape = text_[pos_++];
+            if (escape == 'u') {
+                if (pos_ + 4 > text_.size()) {
+                    return false;
+                }
+                unsigned code = 0;
+                for (int i = 0; i < 4; ++i) {
+                    char h = text_[pos_++];
+                    code *= 16;
+                    if (h >= '0' && h <= '9') {
+                        code += h - '0';
+                    } else if (h >= 'a' && h <= 'f') {
+                        code += h - 'a' + 10;
+                    } else if (h >= 'A' && h <= 'F') {
+                        code += h - 'A' + 10;
+                    } else {
+                        return false;
+                    }
+                }
+                if (code >= 0x80) {
+                    return false; // the trace only escapes control characters
+                }
+                out += static_cast<char>(code);
+            } else if (escape == '"' || escape == '\\' || escape == '/') {
+                out += escape;
+            } else if (escape == 'n') {
+                out += '\n';
+            } else if (escape == 't') {
+                out += '\t';
+            } else if (escape == 'r') {
+                out += '\r';
+            } else if (escape == 'b') {
+                out += '\b';
+            } else if (escape == 'f') {
+                out += '\f';
+            } else {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    bool number() {
+        skip_space();
+        std::size_t start = pos_;
+        if (pos_ < text_.size() && text_[pos_] == '-') {
+            ++pos_;
+        }
+        while (pos_ < text_.size() && std::string("0123456789.eE+-").find(text_[pos_]) != std::string::npos) {
+            ++pos_;
+        }
+        return pos_ > start;
+    }
+
+    bool value() {
+        skip_space();
+        if (pos_ >= text_.size()) {
+            return false;
+        }
+        char c = text_[pos_];
+        if (c == '{') {
+            ++pos_;
+            if (eat('}')) {
+                return true;
+            }
+            do {
+                std::string key, text;
+                if (!string(key) || !eat(':')) {
+                    return false;
+                }
+                skip_space();
+                if (key == "name" && pos_ < text_.size() && text_[pos_] == '"') {
+                    if (!string(text)) {
+                        return false;
+                    }
+                    names.push_back(text);
+                } else if (!value()) {
+                    return false;
+                }
+            } while (eat(','));
+            return eat('}');
+        }
+        if (c == '[') {
+            ++pos_;
+            if (eat(']')) {
+                return true;
+            }
+            do {
+                if (!value()) {
+                    return false;
+                }
+            } while (eat(','));
+            return eat(']');
+        }
+        if (c == '"') {
+            std::string ignored;
+            return string(ignored);
+        }
+        for (const char *word : {"true", "false", "null"}) {
+            if (text_.compare(pos_, std::char_traits<char>::length(word), word) == 0) {
+                pos_ += std::char_traits<char>::length(word);
+                return true;
+            }
+        }
+        return number();
+    }
+};
+
+// control characters are shown as <xx>, everything else as is
+std::string visible(const std::string &name) {
+    std::string out;
+    for (char c : name) {
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            std::snprintf(code, sizeof code, "<%02x>", c);
+            out += code;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+// each input line is a command as typed; "\xx" stands for the byte xx. The
+// lines become event names, as cli.cpp records commands, and the written
+// trace must parse as JSON and give the names back unchanged
+int main() {
+    freopen("trace.in", "r", stdin);
+    freopen("trace.out", "w", stdout);
+
+    std::vector<std::string> commands;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::string command;
+        for (std::size_t i = 0; i < line.size(); ++i) {
+            if (line[i] == '\\' && i + 2 < line.size() && line[i + 1] == 'x') {
+                command += static_cast<char>(std::stoi(line.substr(i + 2, 2), nullptr, 16));
+                i += 3;
+            } else {
+                command += line[i];
+            }
+        }
+        commands.push_back(command);
+    }
+
+    const std::string path = "trace.json";
+    trace::start(path);
+    for (const std::string &command : commands) {
+        std::uint64_t start = trace::now_ns();
+        trace::record(trace::intern(command), start, start + 1000);
+    }
+    trace::stop();
+
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    JsonReader reader(text.str());
+    if (!reader.parse()) {
+        std::cout << "invalid JSON" << std::endl;
+        return 1;
+    }
+    std::cout << "valid JSON, " << reader.names.size() << " names" << std::endl;
+    std::size_t matched = 0;
+    for (const std::string &name : reader.names) {
+        if (name == "thread_name" || name.rfind("thread ", 0) == 0) {
+            continue;
+        }
+        bool same = matched < commands.size() && name == commands[matched];
+        std::cout << visible(name) << (same ? "" : "  DIFFERS") << std::endl;
+        ++matched;
+    }
+    std::cout << matched << " of " << commands.size() << " events" << std::endl;
+}
@@ -0,0 +1,50 @@
+// sends each line of stdin to a running `calculator --server <socket>` and
+// prints the responses, so the existing scripts can be replayed remotely.
+// The interactive two-line form of `poly new <name>` is folded into a single
+// request, since every request is exactly one line.
+//
+//   calc_client <socket> < poly.txt
+#include "client.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+bool needs_terms_line(const std::string &line) {
+    std::istringstream iss(line);
+    std::string command, sub, name, extra;
+    return (iss >> command >> sub >> name) && command == "poly" && sub == "new" && !(iss >> extra);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "usage: calc_client <socket>\n";
+        return 1;
+    }
+    try {
+        ServerConnection connection(argv[1]);
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            std::string terms;
+            if (needs_terms_line(line) && std::getline(std::cin, terms)) {
+                line += ' ' + terms;
+            }
+            ServerResponse response = connection.request(line);
+            if (!response.ok) {
+                std::cout << "错误：";
+            }
+            std::cout << response.body;
+            if (line == "exit" || line == "quit") {
+                break;
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// closed-loop load driver for `calculator --server <socket>`
+//
+//   calc_loadtest <socket> [--connections C] [--requests N] [--setup CMD]... [--command CMD]...
+//
+// every connection runs the --setup commands once, then issues N requests
+// cycling through the --command list, waiting for each response before
+// sending the next. Latencies of all connections are merged for the report.
+#include "client.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string socket_path;
+    std::size_t connections = 4;
+    std::size_t requests = 1000;
+    std::vector<std::string> setup;
+    std::vector<std::string> commands;
+};
+
+struct Result {
+    std::vector<std::uint64_t> latencies_ns;
+    std::size_t errors = 0;
+    std::string failure;
+};
+
+void run_connection(const Options &options, Result &result) {
+    try {
+        ServerConnection connection(options.socket_path);
+        for (const auto &line : options.setup) {
+            connection.request(line);
+        }
+        result.latencies_ns.reserve(options.requests);
+        for (std::size_t i = 0; i < options.requests; ++i) {
+            const std::string &line = options.commands[i % options.commands.size()];
+            auto start = std::chrono::steady_clock::now();
+            ServerResponse response = connection.request(line);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            result.latencies_ns.push_back(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            if (!response.ok) {
+                ++result.errors;
+            }
+        }
+    } catch (const std::exception &e) {
+        result.failure = e.what();
+    }
+}
+
+double percentile_us(const std::vector<std::uint64_t> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    auto rank = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return static_cast<double>(sorted[rank]) / 1e3;
+}
+
+[[noreturn]] void usage() {
+    std::cerr << "usage: calc_loadtest <socket> [--connections C] [--requests N] [--setup CMD]... [--command CMD]...\n";
+    std::exit(1);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+    }
+    Options options;
+    options.socket_path = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+        }
+        const char *value = argv[++i];
+        if (arg == "--connections") {
+            options.connections = std::max(1ULL, std::strtoull(value, nullptr, 10));
+        } else if (arg == "--requests") {
+            options.requests = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--setup") {
+            options.setup.emplace_back(value);
+        } else if (arg == "--command") {
+            options.commands.emplace_back(value);
+        } else {
+            usage();
+        }
+    }
+    if (options.commands.empty()) {
+        options.commands.emplace_back("expr 1+2*3");
+    }
+
+    std::vector<Result> results(options.connections);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < options.connections; ++i) {
+        threads.emplace_back(run_connection, std::cref(options), std::ref(results[i]));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::uint64_t> latencies;
+    std::size_t errors = 0;
+    for (const auto &result : results) {
+        if (!result.failure.empty()) {
+            std::cerr << "connection failed: " << result.failure << '\n';
+        }
+        latencies.insert(latencies.end(), result.latencies_ns.begin(), result.latencies_ns.end());
+        errors += result.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("connections %zu, requests %zu, errors %zu, %.3f s\n", options.connections, latencies.size(), errors,
+                seconds);
+    std::printf("throughput  %.0f req/s\n", static_cast<double>(latencies.size()) / seconds);
+    std::printf("latency us  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", percentile_us(latencies, 0.5),
+                percentile_us(latencies, 0.9), percentile_us(latencies, 0.99), percentile_us(latencies, 0.999),
+                latencies.empty() ? 0.0 : static_cast<double>(latencies.back()) / 1e3);
+    return errors == 0 && latencies.size() == options.connections * options.requests ? 0 : 1;
+}
@@ -0,0 +1,494 @@
+// seeded generator of large inputs for load testing
+//
+//   workload_gen expr [--count N] [--depth D] [--fanout F] [--ops "+-*/^"] [--digits K]
+//                     [--error-rate R] [--format cli|test] [--seed S] [-o file]
+//   workload_gen poly [--count N] [--terms T] [--density D] [--min-exp A] [--max-exp B]
+//                     [--ops "+-*ed"] [--format cli|test] [--seed S] [-o file]
+//
+// --format cli emits scripts for the interactive binary (expr.txt / poly.txt),
+// --format test emits test/expression.in / test/polynomial.in style input.
+// The same seed and options always produce the same bytes. Expressions are
+// only written if evaluating them keeps every fraction within 64 bits, and
+// polynomial exponents (and their sums, with "*") must fit in an int.
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace {
+
+// splitmix64: tiny, fast and identical on every platform, unlike the
+// std::*_distribution adaptors
+struct Random {
+    std::uint64_t state;
+
+    std::uint64_t next() {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+    std::uint64_t below(std::uint64_t bound) {
+        return bound == 0 ? 0 : next() % bound;
+    }
+    double unit() {
+        return static_cast<double>(next() >> 11) * 0x1.0p-53;
+    }
+};
+
+class Output {
+public:
+    explicit Output(std::FILE *file) : file_(file) {
+        buffer_.reserve(CAPACITY);
+    }
+    ~Output() {
+        flush();
+    }
+
+    void put(char ch) {
+        buffer_.push_back(ch);
+        if (buffer_.size() >= CAPACITY) {
+            flush();
+        }
+    }
+    void put(const char *text) {
+        buffer_.insert(buffer_.end(), text, text + std::strlen(text));
+        if (buffer_.size() >= CAPACITY) {
+            flush();
+        }
+    }
+    void put(const std::string &text) {
+        put(text.c_str());
+    }
+    template <typename T, typename... Format>
+    void number(T value, Format... format) {
+        char digits[64];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value, format...);
+        buffer_.insert(buffer_.end(), digits, result.ptr);
+        if (buffer_.size() >= CAPACITY) {
+            flush();
+        }
+    }
+    void flush() {
+        if (!buffer_.empty()) {
+            std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+            buffer_.clear();
+        }
+    }
+
+private:
+    static constexpr std::size_t CAPACITY = 1 << 20;
+
+    std::FILE *file_;
+    std::vector<char> buffer_;
+};
+
+struct Options {
+    std::uint64_t seed = 1;
+    long long count = 100;
+    bool cli = true;
+    std::string output;
+    // expressions
+    int depth = 3;
+    int fanout = 4;
+    std::string expr_ops = "+-*/";
+    int digits = 2;
+    double error_rate = 0.0;
+    // polynomials
+    long long terms = 10;
+    double density = 1.0;
+    long long min_exp = 0;
+    long long max_exp = 1000000;
+    std::string poly_ops = "+-*";
+};
+
+// the exact value of a generated expression, computed the way Fraction
+// does it but with every step checked, so that an expression whose
+// evaluation would overflow 64 bits (undefined behaviour in the calculator)
+// is regenerated instead of written
+struct Value {
+    long long numerator = 0;
+    long long denominator = 1;
+    bool valid = true;
+};
+
+Value make_value(long long numerator, long long denominator) {
+    // like Fraction::normalize
+    Value value{numerator, denominator};
+    if (denominator == 1) {
+        return value;
+    }
+    if (numerator == LLONG_MIN || denominator == LLONG_MIN) {
+        value.valid = false;
+        return value;
+    }
+    if (denominator < 0) {
+        value.numerator = -numerator;
+        value.denominator = -denominator;
+    }
+    long long d = std::gcd(value.numerator, value.denominator);
+    value.numerator /= d;
+    value.denominator /= d;
+    return value;
+}
+
+Value apply(const Value &a, char op, const Value &b) {
+    Value invalid{0, 1, false};
+    if (!a.valid || !b.valid) {
+        return invalid;
+    }
+    long long x, y, numerator, denominator;
+    switch (op) {
+    case '+':
+    case '-':
+        if (__builtin_mul_overflow(a.numerator, b.denominator, &x) || __builtin_mul_overflow(b.numerator, a.denominator, &y)
+            || (op == '+' ? __builtin_add_overflow(x, y, &numerator) : __builtin_sub_overflow(x, y, &numerator))
+            || __builtin_mul_overflow(a.denominator, b.denominator, &denominator)) {
+            return invalid;
+        }
+        break;
+    case '*':
+        if (__builtin_mul_overflow(a.numerator, b.numerator, &numerator)
+            || __builtin_mul_overflow(a.denominator, b.denominator, &denominator)) {
+            return invalid;
+        }
+        break;
+    default:
+        // a division by zero is an error case, not a valid expression
+        if (b.numerator == 0 || __builtin_mul_overflow(a.numerator, b.denominator, &numerator)
+            || __builtin_mul_overflow(a.denominator, b.numerator, &denominator)) {
+            return invalid;
+        }
+        break;
+    }
+    return make_value(numerator, denominator);
+}
+
+Value power(const Value &base, long long exponent) {
+    // the square-and-multiply loop of Fraction's operator^
+    if (!base.valid || exponent > INT_MAX) {
+        return Value{0, 1, false};
+    }
+    Value result{1, 1};
+    Value factor = base;
+    while (exponent) {
+        if (exponent & 1) {
+            result = apply(result, '*', factor);
+        }
+        if (exponent > 1) {
+            factor = apply(factor, '*', factor);
+        }
+        exponent >>= 1;
+    }
+    return result;
+}
+
+Value literal(std::string &text, Random &rng, int digits) {
+    int length = 1 + static_cast<int>(rng.below(static_cast<std::uint64_t>(digits)));
+    long long value = static_cast<long long>(1 + rng.below(9));
+    text += static_cast<char>('0' + value);
+    for (int i = 1; i < length; ++i) {
+        int digit = static_cast<int>(rng.below(10));
+        text += static_cast<char>('0' + digit);
+        value = value * 10 + digit; // at most 18 digits
+    }
+    return Value{value, 1};
+}
+
+Value expression(std::string &text, Random &rng, const Options &options, int depth) {
+    // fanout operands joined by random operators; an operand is a
+    // parenthesised subexpression while depth remains. The value follows
+    // the parser: '^' binds right to left, then '*' and '/', then '+' and
+    // '-', each left to right
+    int operands = 2 + static_cast<int>(rng.below(static_cast<std::uint64_t>(options.fanout - 1)));
+    Value sum;
+    char sum_op = 0;
+    Value product;
+    char product_op = 0;
+    Value operand;
+    std::vector<long long> exponents;
+    auto close_operand = [&] {
+        if (!exponents.empty()) {
+            long long exponent = exponents.back();
+            for (std::size_t k = exponents.size() - 1; k-- > 0;) {
+                Value chain = power(Value{exponents[k], 1}, exponent);
+                exponent = chain.valid ? chain.numerator : LLONG_MAX;
+            }
+            operand = power(operand, exponent);
+            exponents.clear();
+        }
+        product = product_op ? apply(product, product_op, operand) : operand;
+    };
+    for (int i = 0; i < operands; ++i) {
+        if (i > 0) {
+            char op = options.expr_ops[rng.below(options.expr_ops.size())];
+            text += ' ';
+            text += op;
+            text += ' ';
+            if (op == '^') {
+                // keep powers small, the operands are already random
+                exponents.push_back(static_cast<long long>(rng.below(4)));
+                text += std::to_string(exponents.back());
+                continue;
+            }
+            close_operand();
+            if (op == '+' || op == '-') {
+                sum = sum_op ? apply(sum, sum_op, product) : product;
+                sum_op = op;
+                product_op = 0;
+            } else {
+                product_op = op;
+            }
+        }
+        if (depth > 0 && rng.below(3) != 0) {
+            text += '(';
+            operand = expression(text, rng, options, depth - 1);
+            text += ')';
+        } else {
+            operand = literal(text, rng, options.digits);
+        }
+    }
+    close_operand();
+    return sum_op ? apply(sum, sum_op, product) : product;
+}
+
+std::string valid_expression(Random &rng, const Options &options, int depth) {
+    // regenerates until the value fits; with the same seed the retries,
+    // and so the output, are the same every time
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        std::string text;
+        if (expression(text, rng, options, depth).valid) {
+            return text;
+        }
+    }
+    std::cerr << "cannot generate expressions whose values fit in 64 bits, lower --depth, --fanout or --digits\n";
+    std::exit(1);
+}
+
+void error_case(Output &out, Random &rng, const Options &options) {
+    // the parser evaluates part of a broken expression before it fails,
+    // so the valid parts must not overflow either
+    std::string text;
+    switch (rng.below(4)) {
+    case 0:
+        literal(text, rng, options.digits);
+        out.put(text);
+        out.put(" / (3 - 3)");
+        break;
+    case 1:
+        out.put("((");
+        out.put(valid_expression(rng, options, 0));
+        out.put(')');
+        break;
+    case 2:
+        out.put(valid_expression(rng, options, 0));
+        out.put(" *");
+        break;
+    default:
+        out.put(valid_expression(rng, options, 0));
+        out.put(" + x");
+        break;
+    }
+}
+
+void generate_expressions(Output &out, const Options &options) {
+    Random rng{options.seed};
+    if (!options.cli) {
+        out.number(options.count);
+        out.put('\n');
+    }
+    for (long long i = 0; i < options.count; ++i) {
+        if (options.cli) {
+            out.put("expr ");
+        }
+        if (rng.unit() < options.error_rate) {
+            error_case(out, rng, options);
+        } else {
+            out.put(valid_expression(rng, options, options.depth));
+        }
+        out.put('\n');
+    }
+    if (options.cli) {
+        out.put("exit\n");
+    }
+}
+
+void coefficient(Output &out, Random &rng) {
+    // integers and one-decimal values, like poly.txt
+    long long value = static_cast<long long>(rng.below(200)) - 100;
+    if (value == 0) {
+        value = 1;
+    }
+    if (rng.below(4) == 0) {
+        if (value < 0) {
+            out.put('-');
+            value = -value;
+        }
+        out.number(value / 10);
+        out.put('.');
+        out.number(value % 10);
+    } else {
+        out.number(value);
+    }
+}
+
+void polynomial(Output &out, Random &rng, const Options &options) {
+    // exponents walk upwards from min_exp with gaps averaging 1 / density
+    long long span = options.max_exp - options.min_exp + 1;
+    long long terms = std::min(options.terms, span);
+    double mean_gap = std::max(1.0, 1.0 / options.density);
+    long long max_gap = std::max(1LL, std::min(static_cast<long long>(2 * mean_gap) - 1, span / terms));
+    out.number(terms);
+    long long exponent = options.min_exp;
+    for (long long i = 0; i < terms; ++i) {
+        out.put(' ');
+        coefficient(out, rng);
+        out.put(' ');
+        out.number(exponent);
+        exponent += 1 + static_cast<long long>(rng.below(static_cast<std::uint64_t>(max_gap)));
+    }
+    out.put('\n');
+}
+
+void generate_polynomials(Output &out, const Options &options) {
+    Random rng{options.seed};
+    if (options.cli) {
+        // define count polynomials, then one operation per adjacent pair
+        for (long long i = 1; i <= options.count; ++i) {
+            out.put("poly new p");
+            out.number(i);
+            out.put('\n');
+            polynomial(out, rng, options);
+        }
+        for (long long i = 1; i < options.count; ++i) {
+            char op = options.poly_ops[rng.below(options.poly_ops.size())];
+            switch (op) {
+            case '+': out.put("poly add p"); break;
+            case '-': out.put("poly sub p"); break;
+            case '*': out.put("poly mul p"); break;
+            case 'e': out.put("poly eval p"); break;
+            default: out.put("poly deriv p"); break;
+            }
+            out.number(i);
+            if (op == 'e') {
+                out.put(' ');
+                out.number(static_cast<double>(rng.below(2001)) / 1000.0 - 1.0, std::chars_format::fixed, 3);
+            } else if (op != 'd') {
+                out.put(" p");
+                out.number(i + 1);
+            }
+            out.put(op == 'e' ? "\n" : " -l\n");
+        }
+        out.put("exit\n");
+        return;
+    }
+    out.number(options.count);
+    out.put('\n');
+    for (long long i = 0; i < options.count; ++i) {
+        polynomial(out, rng, options);
+        polynomial(out, rng, options);
+        char op = options.poly_ops[rng.below(options.poly_ops.size())];
+        out.put(op);
+        if (op == 'e') {
+            out.put(' ');
+            out.number(static_cast<double>(rng.below(2001)) / 1000.0 - 1.0, std::chars_format::fixed, 3);
+        }
+        out.put('\n');
+    }
+}
+
+[[noreturn]] void usage() {
+    std::cerr << "usage: workload_gen expr|poly [options], see the header of tools/workload_gen.cpp\n";
+    std::exit(1);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+    }
+    std::string mode = argv[1];
+    if (mode != "expr" && mode != "poly") {
+        usage();
+    }
+    Options options;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+        }
+        const char *value = argv[++i];
+        if (arg == "--seed") {
+            options.seed = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--count") {
+            options.count = std::atoll(value);
+        } else if (arg == "--format") {
+            options.cli = std::string(value) != "test";
+        } else if (arg == "-o") {
+            options.output = value;
+        } else if (arg == "--depth") {
+            options.depth = std::atoi(value);
+        } else if (arg == "--fanout") {
+            options.fanout = std::max(2, std::atoi(value));
+        } else if (arg == "--ops") {
+            (mode == "expr" ? options.expr_ops : options.poly_ops) = value;
+        } else if (arg == "--digits") {
+            options.digits = std::max(1, std::atoi(value));
+        } else if (arg == "--error-rate") {
+            options.error_rate = std::strtod(value, nullptr);
+        } else if (arg == "--terms") {
+            options.terms = std::max(1LL, std::atoll(value));
+        } else if (arg == "--density") {
+            options.density = std::strtod(value, nullptr);
+        } else if (arg == "--min-exp") {
+            options.min_exp = std::atoll(value);
+        } else if (arg == "--max-exp") {
+            options.max_exp = std::atoll(value);
+        } else {
+            usage();
+        }
+    }
+    if (options.expr_ops.empty() || options.poly_ops.empty() || options.density <= 0.0 || options.max_exp < options.min_exp) {
+        usage();
+    }
+    if (options.expr_ops.find_first_not_of("+-*/^") != std::string::npos) {
+        std::cerr << "--ops for expressions takes only + - * / ^\n";
+        return 1;
+    }
+    if (options.digits > 18) {
+        std::cerr << "--digits is at most 18, longer literals do not fit in 64 bits\n";
+        return 1;
+    }
+    // exponents are ints in the calculator, and a product adds them
+    long long exponent_limit = options.poly_ops.find('*') == std::string::npos ? INT_MAX : INT_MAX / 2;
+    if (options.min_exp < -exponent_limit || options.max_exp > exponent_limit) {
+        std::cerr << "exponents must lie within +-" << exponent_limit << " for these --ops\n";
+        return 1;
+    }
+
+    std::FILE *file = options.output.empty() ? stdout : std::fopen(options.output.c_str(), "wb");
+    if (!file) {
+        std::cerr << "cannot open " << options.output << '\n';
+        return 1;
+    }
+    {
+        Output out(file);
+        if (mode == "expr") {
+            generate_expressions(out, options);
+        } else {
+            generate_polynomials(out, options);
+        }
+    }
+    if (file != stdout) {
+        std::fclose(file);
+    }
+    return 0;
+}